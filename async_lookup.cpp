@@ -0,0 +1,22 @@
+#include "async_lookup.h"
+
+void LookupScheduler::spawn(LookupTask<void> task) {
+	_ready.push_back(task._h);
+	_tasks.push_back(std::move(task));
+}
+
+void LookupScheduler::run() {
+	while (!_ready.empty()) {
+		std::coroutine_handle<> h = _ready.front();
+		_ready.pop_front();
+		h.resume();
+	}
+
+	// Tutte le richieste sono terminate: si raccolgono le eccezioni
+	// e si liberano le coroutine
+	std::vector<LookupTask<void>> done;
+	done.swap(_tasks);
+
+	for (LookupTask<void> &t : done)
+		t._h.promise().take();
+}
@@ -0,0 +1,204 @@
+#ifndef ASYNC_LOOKUP_H
+#define ASYNC_LOOKUP_H
+
+#include <coroutine> // std::coroutine_handle
+#include <deque> // std::deque
+#include <vector> // std::vector
+#include <exception> // std::exception_ptr
+#include <utility> // std::move, std::exchange
+
+template <typename T>
+class LookupTask;
+
+/**
+	@brief Parte comune delle promise di LookupTask
+
+	Memorizza la coroutine da riprendere al termine (continuation) e
+	l'eventuale eccezione. Le coroutine partono sospese e vengono
+	avviate solo quando qualcuno le attende o le affida allo scheduler.
+*/
+struct lookup_promise_base {
+	std::coroutine_handle<> continuation; // chi attende il risultato
+	std::exception_ptr error; // eccezione sollevata dalla coroutine
+
+	/**
+		Al termine riprende direttamente chi attende il risultato
+		(symmetric transfer), oppure restituisce il controllo allo
+		scheduler se la coroutine è di primo livello
+	*/
+	struct final_awaiter {
+		bool await_ready() const noexcept { return false; }
+
+		template <typename P>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) const noexcept {
+			if (h.promise().continuation)
+				return h.promise().continuation;
+			return std::noop_coroutine();
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	std::suspend_always initial_suspend() const noexcept { return std::suspend_always(); }
+
+	final_awaiter final_suspend() const noexcept { return final_awaiter(); }
+
+	void unhandled_exception() { error = std::current_exception(); }
+};
+
+/**
+	@brief Promise di LookupTask con risultato di tipo T
+*/
+template <typename T>
+struct lookup_promise : lookup_promise_base {
+	T result; // risultato della coroutine
+
+	LookupTask<T> get_return_object() {
+		return LookupTask<T>(std::coroutine_handle<lookup_promise>::from_promise(*this));
+	}
+
+	void return_value(T v) { result = std::move(v); }
+
+	T take() {
+		if (error)
+			std::rethrow_exception(error);
+		return std::move(result);
+	}
+};
+
+/**
+	@brief Promise di LookupTask senza risultato
+*/
+template <>
+struct lookup_promise<void> : lookup_promise_base {
+	LookupTask<void> get_return_object();
+
+	void return_void() {}
+
+	void take() {
+		if (error)
+			std::rethrow_exception(error);
+	}
+};
+
+/**
+	@brief Classe LookupTask
+
+	Tipo restituito dalle coroutine di ricerca asincrona (ad esempio
+	Map::async_find). Può essere attesa con co_await da un'altra
+	coroutine oppure, se di tipo LookupTask<void>, affidata ad un
+	LookupScheduler come richiesta di primo livello.
+*/
+template <typename T>
+class LookupTask {
+public:
+	typedef lookup_promise<T> promise_type;
+	typedef std::coroutine_handle<promise_type> handle_type;
+
+	LookupTask(LookupTask &&other) noexcept : _h(std::exchange(other._h, nullptr)) {}
+
+	LookupTask& operator=(LookupTask &&other) noexcept {
+		if (this != &other) {
+			if (_h)
+				_h.destroy();
+			_h = std::exchange(other._h, nullptr);
+		}
+		return *this;
+	}
+
+	~LookupTask() {
+		if (_h)
+			_h.destroy();
+	}
+
+	/**
+		Attesa del risultato: la coroutine chiamante viene sospesa e
+		la coroutine del task viene avviata al suo posto
+	*/
+	struct awaiter {
+		handle_type h;
+
+		bool await_ready() const noexcept { return !h || h.done(); }
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) const noexcept {
+			h.promise().continuation = caller;
+			return h;
+		}
+
+		T await_resume() const { return h.promise().take(); }
+	};
+
+	awaiter operator co_await() const noexcept { return awaiter{_h}; }
+
+private:
+	friend struct lookup_promise<T>;
+	friend class LookupScheduler;
+
+	explicit LookupTask(handle_type h) : _h(h) {}
+
+	LookupTask(const LookupTask &other); // non copiabile
+	LookupTask& operator=(const LookupTask &other); // non assegnabile
+
+	handle_type _h; // coroutine posseduta dal task
+};
+
+inline LookupTask<void> lookup_promise<void>::get_return_object() {
+	return LookupTask<void>(std::coroutine_handle<lookup_promise>::from_promise(*this));
+}
+
+/**
+	@brief Classe LookupScheduler
+
+	Scheduler cooperativo a singolo thread per le ricerche asincrone.
+	Le coroutine di ricerca, prima di accedere ad un nodo, ne
+	richiedono il prefetch e si sospendono con yield(): lo scheduler
+	riprende nel frattempo le altre ricerche in attesa, così le latenze
+	di accesso alla memoria di ricerche indipendenti si sovrappongono
+	invece di sommarsi.
+*/
+class LookupScheduler {
+public:
+	/**
+		Awaiter che rimette la coroutine corrente in fondo alla coda
+		delle coroutine pronte
+	*/
+	struct yield_awaiter {
+		LookupScheduler &s;
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(std::coroutine_handle<> h) const { s._ready.push_back(h); }
+
+		void await_resume() const noexcept {}
+	};
+
+	/**
+		@brief Sospende la coroutine corrente cedendo il turno.
+
+		@return awaiter da usare con co_await
+	*/
+	yield_awaiter yield() { return yield_awaiter{*this}; }
+
+	/**
+		@brief Affida allo scheduler una richiesta di primo livello.
+
+		La richiesta viene avviata alla successiva chiamata di run().
+
+		@param task coroutine da eseguire
+	*/
+	void spawn(LookupTask<void> task);
+
+	/**
+		@brief Esegue le richieste affidate finché non sono tutte
+		completate.
+
+		@throw rilancia la prima eccezione sollevata da una richiesta
+	*/
+	void run();
+
+private:
+	std::deque<std::coroutine_handle<>> _ready; // coroutine pronte
+	std::vector<LookupTask<void>> _tasks; // richieste di primo livello
+};
+
+#endif
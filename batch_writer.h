@@ -0,0 +1,143 @@
+#ifndef BATCH_WRITER_H
+#define BATCH_WRITER_H
+
+#include <vector> // std::vector
+#include <mutex> // std::mutex, std::lock_guard
+#include <chrono> // std::chrono::steady_clock
+#include "map.h"
+
+/**
+	@brief Classe BatchWriter
+
+	Buffer di scrittura per un singolo thread. Le put e le erase vengono
+	accumulate localmente, senza lock, e applicate alla mappa condivisa
+	con Map::apply_batch: un solo lock e una sola passata sulla lista per
+	blocco, invece di un lock e una ricerca completa per ogni scrittura.
+
+	Il blocco viene applicato quando raggiunge flush_size operazioni,
+	quando la più vecchia operazione in attesa supera max_latency
+	(controllato ad ogni nuova scrittura, non esiste un thread in
+	background), con flush() o alla distruzione.
+
+	Ogni thread usa il proprio BatchWriter; tutti condividono la mappa
+	ed il mutex che la protegge, che deve essere usato anche dagli
+	altri accessi alla mappa. Le scritture di un thread diventano
+	visibili agli altri solo dopo il flush.
+
+	Per le semantiche di put ed erase vedi Map::apply_batch.
+*/
+template <typename C, typename V, typename Eq, typename H = no_hash<C>>
+class BatchWriter {
+public:
+	typedef std::chrono::steady_clock clock;
+
+	/**
+		Costruttore
+
+		@param map mappa condivisa
+		@param mutex mutex che protegge la mappa
+		@param flush_size numero di operazioni che provoca il flush
+		@param max_latency attesa massima di un'operazione nel buffer
+	*/
+	BatchWriter(Map<C, V, Eq, H> &map, std::mutex &mutex, std::size_t flush_size = 256,
+		clock::duration max_latency = std::chrono::milliseconds(1))
+		: _map(map), _mutex(mutex), _flush_size(flush_size ? flush_size : 1), _max_latency(max_latency) {
+		_ops.reserve(_flush_size);
+	}
+
+	BatchWriter(const BatchWriter &) = delete;
+	BatchWriter &operator=(const BatchWriter &) = delete;
+
+	/**
+		Distruttore
+
+		Applica le operazioni ancora in attesa. Se l'applicazione
+		fallisce le operazioni vengono perse: per gestire l'errore
+		chiamare flush() prima della distruzione.
+	*/
+	~BatchWriter() {
+		try {
+			flush();
+		} catch(...) {
+			// un distruttore non deve lanciare eccezioni
+		}
+	}
+
+	/**
+		@brief Inserisce una coppia o ne sostituisce il valore.
+	*/
+	void put(const C &k, const V &v) {
+		push(BatchOp<C, V>::put, k, v);
+	}
+
+	/**
+		@brief Rimuove una coppia, se presente.
+	*/
+	void erase(const C &k) {
+		push(BatchOp<C, V>::erase, k, V());
+	}
+
+	/**
+		@brief Applica alla mappa le operazioni in attesa.
+
+		@return esito del blocco applicato
+		@throw se l'allocazione o la copia falliscono lancia
+		un'eccezione; il buffer viene comunque svuotato
+	*/
+	BatchResult flush() {
+		BatchResult r;
+		if (_ops.empty())
+			return r;
+
+		try {
+			std::lock_guard<std::mutex> lock(_mutex);
+			r = _map.apply_batch(_ops);
+		} catch(...) {
+			_ops.clear();
+			throw;
+		}
+
+		_ops.clear();
+		_total.inserted += r.inserted;
+		_total.updated += r.updated;
+		_total.removed += r.removed;
+		_total.discarded += r.discarded;
+		return r;
+	}
+
+	/**
+		@return numero di operazioni in attesa
+	*/
+	std::size_t pending() const {
+		return _ops.size();
+	}
+
+	/**
+		@return somma degli esiti dei blocchi applicati da questo writer
+	*/
+	const BatchResult &totals() const {
+		return _total;
+	}
+
+private:
+	void push(typename BatchOp<C, V>::kind type, const C &k, const V &v) {
+		clock::time_point now = clock::now();
+		if (_ops.empty())
+			_oldest = now;
+
+		_ops.push_back(BatchOp<C, V>{type, k, v});
+
+		if (_ops.size() >= _flush_size || now - _oldest >= _max_latency)
+			flush();
+	}
+
+	Map<C, V, Eq, H> &_map; // mappa condivisa
+	std::mutex &_mutex; // mutex della mappa
+	std::size_t _flush_size; // dimensione massima del blocco
+	clock::duration _max_latency; // attesa massima nel buffer
+	std::vector<BatchOp<C, V>> _ops; // operazioni in attesa
+	clock::time_point _oldest; // arrivo della prima operazione in attesa
+	BatchResult _total; // esiti cumulati
+};
+
+#endif
@@ -0,0 +1,99 @@
+/*
+	Benchmark delle ricerche asincrone con coroutine (Map::async_find)
+	rispetto alle ricerche sincrone con Map::find. Entrambe percorrono
+	la lista una sola volta, per cui la differenza misura solo
+	l'effetto dell'interleaving delle ricerche.
+
+	Compilazione: make bench.exe
+*/
+#include <iostream> // std::cout
+#include <chrono> // std::chrono::steady_clock
+#include <random> // std::mt19937
+#include <vector> // std::vector
+#include <algorithm> // std::shuffle
+#include <cstdlib> // std::atoi
+#include "map.h"
+
+/**
+  @brief Funtore di uguaglianza tra tipi interi
+*/
+struct int_equal {
+  bool operator()(int a, int b) const {
+    return a==b;
+  }
+};
+
+typedef Map<int, int, int_equal> mapint;
+
+/**
+  @brief Richiesta di primo livello: cerca le chiavi assegnate
+  e ne somma i valori
+*/
+LookupTask<void> worker(const mapint &map, const std::vector<int> &keys,
+	std::size_t first, std::size_t step, LookupScheduler &sched, long &sum) {
+	for (std::size_t i = first; i < keys.size(); i += step) {
+		const int *v = co_await map.async_find(keys[i], sched);
+		if (v != nullptr)
+			sum += *v;
+	}
+}
+
+int main(int argc, char *argv[]) {
+	int n = argc > 1 ? std::atoi(argv[1]) : 200000; // coppie nella mappa
+	int lookups = argc > 2 ? std::atoi(argv[2]) : 200; // ricerche
+
+	std::mt19937 rng(42);
+	mapint map;
+
+	// I nodi vengono allocati alternandoli a blocchi di dimensione
+	// casuale, in modo che nodi consecutivi nella lista non siano
+	// contigui in memoria come accadrebbe in una mappa reale
+	std::vector<std::vector<char>> noise;
+	std::vector<int> order(n);
+	for (int i = 0; i < n; ++i)
+		order[i] = i;
+	std::shuffle(order.begin(), order.end(), rng);
+	for (int i = 0; i < n; ++i) {
+		map.add_unchecked(order[i], order[i]);
+		noise.push_back(std::vector<char>(16 + rng() % 512));
+	}
+	noise.clear();
+
+	std::vector<int> keys(lookups);
+	for (int i = 0; i < lookups; ++i)
+		keys[i] = static_cast<int>(rng() % n);
+
+	typedef std::chrono::steady_clock clock;
+
+	clock::time_point t0 = clock::now();
+	long sync_sum = 0;
+	for (int k : keys) {
+		mapint::const_iterator i = map.find(k);
+		if (i != map.end())
+			sync_sum += i->value;
+	}
+	double sync_ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+
+	std::cout << "coppie: " << n << ", ricerche: " << lookups << '\n';
+	std::cout << "find() sincrona:       " << sync_ms << " ms\n";
+
+	for (std::size_t group : {1, 4, 8, 16, 32}) {
+		LookupScheduler sched;
+		std::vector<long> sums(group, 0);
+
+		t0 = clock::now();
+		for (std::size_t g = 0; g < group; ++g)
+			sched.spawn(worker(map, keys, g, group, sched, sums[g]));
+		sched.run();
+		double async_ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+
+		long async_sum = 0;
+		for (long s : sums)
+			async_sum += s;
+
+		std::cout << "async_find, " << group << " richieste: " << async_ms << " ms"
+			<< (async_sum == sync_sum ? "" : " (RISULTATO ERRATO)") << '\n';
+	}
+
+	return 0;
+}
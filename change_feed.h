@@ -0,0 +1,270 @@
+#ifndef CHANGE_FEED_H
+#define CHANGE_FEED_H
+
+#include <vector> // std::vector
+#include <cstdint> // std::uint64_t
+#include <utility> // std::move
+#include "map.h"
+
+/**
+	@brief Struct Change
+
+	Modifica di una mappa registrata nel change feed.
+*/
+template <typename C, typename V>
+struct Change {
+	enum kind {
+		added,   // coppia aggiunta
+		removed, // coppia rimossa (value non significativo)
+		updated  // valore di una coppia esistente modificato
+	};
+
+	std::uint64_t seq; // numero di sequenza, crescente a partire da 1
+	kind type; // tipo di modifica
+	C key; // chiave della coppia
+	V value; // nuovo valore (per added e updated)
+
+	Change() : seq(0), type(added) {}
+
+	Change(std::uint64_t s, kind t, const C &k, const V &v) : seq(s), type(t), key(k), value(v) {}
+};
+
+/**
+	@brief Struct ChangeBatch
+
+	Risultato di una lettura dal change feed.
+*/
+template <typename C, typename V>
+struct ChangeBatch {
+	// true se il consumatore è rimasto indietro rispetto al buffer
+	// circolare: le modifiche richieste sono state sovrascritte e deve
+	// ripartire da uno snapshot completo
+	bool snapshot_required;
+	std::vector<Change<C, V>> changes; // modifiche, in ordine di sequenza
+	std::uint64_t last_seq; // sequenza dell'ultima modifica restituita (da passare alla lettura successiva)
+
+	ChangeBatch() : snapshot_required(false), last_seq(0) {}
+};
+
+/**
+	@brief Classe ChangeFeed
+
+	Buffer circolare di dimensione fissa con le ultime modifiche di una
+	mappa. Ogni modifica riceve un numero di sequenza crescente; quando
+	il buffer è pieno le modifiche più vecchie vengono sovrascritte.
+*/
+template <typename C, typename V>
+class ChangeFeed {
+public:
+	/**
+		Costruttore
+
+		@param capacity numero massimo di modifiche mantenute (almeno 1)
+	*/
+	explicit ChangeFeed(std::size_t capacity)
+		: _ring(capacity ? capacity : 1), _first(0), _count(0), _last_seq(0) {}
+
+	/**
+		@brief Registra una modifica.
+
+		La modifica viene spostata nel buffer, per cui il chiamante può
+		prepararla (copiando chiave e valore) prima di modificare la
+		mappa ed evitare che una copia fallita lasci la modifica
+		applicata ma non registrata.
+
+		@param c modifica da registrare (il campo seq viene assegnato qui)
+		@return numero di sequenza assegnato
+	*/
+	std::uint64_t append(Change<C, V> &&c) {
+		std::size_t pos = (_first + _count) % _ring.size();
+		c.seq = _last_seq + 1;
+		_ring[pos] = std::move(c);
+
+		if (_count == _ring.size())
+			_first = (_first + 1) % _ring.size(); // sovrascritta la più vecchia
+		else
+			_count++;
+
+		return ++_last_seq;
+	}
+
+	/**
+		@brief Legge le modifiche successive ad un numero di sequenza.
+
+		@param seq ultima modifica già applicata dal consumatore
+		@param max numero massimo di modifiche da restituire
+		@return le modifiche con sequenza maggiore di seq, al più max;
+		snapshot_required se alcune di esse non sono più nel buffer
+	*/
+	ChangeBatch<C, V> since(std::uint64_t seq, std::size_t max) const {
+		ChangeBatch<C, V> batch;
+		batch.last_seq = seq;
+
+		std::uint64_t oldest = _last_seq - _count + 1;
+		if (seq > _last_seq || seq + 1 < oldest) {
+			batch.snapshot_required = true;
+			return batch;
+		}
+
+		std::uint64_t n = _last_seq - seq;
+		if (n > max)
+			n = max;
+
+		batch.changes.reserve(static_cast<std::size_t>(n));
+		std::size_t pos = (_first + static_cast<std::size_t>(seq + 1 - oldest)) % _ring.size();
+		for (std::uint64_t i = 0; i < n; ++i) {
+			batch.changes.push_back(_ring[pos]);
+			pos = (pos + 1) % _ring.size();
+		}
+		batch.last_seq = seq + n;
+
+		return batch;
+	}
+
+	/**
+		@return sequenza dell'ultima modifica registrata (0 se nessuna)
+	*/
+	std::uint64_t last_seq() const {
+		return _last_seq;
+	}
+
+private:
+	std::vector<Change<C, V>> _ring; // buffer circolare
+	std::size_t _first; // posizione della modifica più vecchia
+	std::size_t _count; // modifiche presenti nel buffer
+	std::uint64_t _last_seq; // sequenza dell'ultima modifica
+};
+
+/**
+	@brief Classe FeedMap
+
+	Involucro di una Map che registra ogni add, remove e update in un
+	ChangeFeed. I consumatori locali si mantengono allineati leggendo
+	con changes_since solo le modifiche successive all'ultima applicata,
+	con un costo proporzionale al numero di modifiche e non alla
+	dimensione della mappa. Un consumatore nuovo, o rimasto indietro
+	rispetto al buffer, riparte da snapshot().
+
+	Come Map, la classe non è thread-safe: l'accesso concorrente deve
+	essere sincronizzato esternamente.
+*/
+template <typename C, typename V, typename Eq, typename H = no_hash<C>>
+class FeedMap {
+public:
+	/**
+		Costruttore
+
+		@param capacity numero di modifiche mantenute nel feed
+	*/
+	explicit FeedMap(std::size_t capacity = 4096) : _feed(capacity) {}
+
+	/**
+		@brief Aggiunge una coppia alla mappa e la registra nel feed.
+
+		@param k chiave della coppia
+		@param v valore della coppia
+		@throw keyAlreadyDefinedException se la chiave è già presente
+	*/
+	void add(const C &k, const V &v) {
+		Change<C, V> c(0, Change<C, V>::added, k, v);
+		_map.add(k, v);
+		_feed.append(std::move(c));
+	}
+
+	/**
+		@brief Rimuove una coppia dalla mappa e lo registra nel feed.
+
+		@param key chiave della coppia
+		@throw keyNotFoundException se la chiave non è presente
+	*/
+	void remove(const C &key) {
+		Change<C, V> c(0, Change<C, V>::removed, key, V());
+		_map.remove(key);
+		_feed.append(std::move(c));
+	}
+
+	/**
+		@brief Modifica il valore di una coppia esistente e lo registra
+		nel feed.
+
+		@param key chiave della coppia
+		@param v nuovo valore
+		@throw keyNotFoundException se la chiave non è presente
+	*/
+	void update(const C &key, const V &v) {
+		typename Map<C, V, Eq, H>::iterator i = _map.find(key);
+		if (i == _map.end())
+			throw keyNotFoundException("Chiave non trovata nella mappa.");
+
+		Change<C, V> c(0, Change<C, V>::updated, key, v);
+		i->value = v;
+		_feed.append(std::move(c));
+	}
+
+	/**
+		@brief Verifica l'esistenza di una coppia nella mappa.
+	*/
+	bool exists(const C &key) const {
+		return _map.exists(key);
+	}
+
+	/**
+		@brief Restituisce il valore associato ad una chiave
+
+		@throw keyNotFoundException se la chiave non è presente
+	*/
+	const V& value(const C &key) const {
+		return _map.value(key);
+	}
+
+	/**
+		@return numero di coppie presenti nella mappa
+	*/
+	unsigned int size() const {
+		return _map.size();
+	}
+
+	/**
+		@return la mappa, per l'accesso in lettura
+	*/
+	const Map<C, V, Eq, H> &map() const {
+		return _map;
+	}
+
+	/**
+		@brief Legge le modifiche successive all'ultima applicata.
+
+		@param seq sequenza dell'ultima modifica applicata dal consumatore
+		(quella restituita da snapshot o dalla lettura precedente)
+		@param max numero massimo di modifiche da restituire
+		@return blocco di modifiche; se snapshot_required il consumatore
+		deve ripartire da snapshot()
+	*/
+	ChangeBatch<C, V> changes_since(std::uint64_t seq, std::size_t max = 1024) const {
+		return _feed.since(seq, max);
+	}
+
+	/**
+		@brief Copia completa della mappa per un nuovo consumatore.
+
+		@param out mappa in cui copiare il contenuto
+		@return sequenza dell'ultima modifica contenuta nella copia
+	*/
+	std::uint64_t snapshot(Map<C, V, Eq, H> &out) const {
+		out = _map;
+		return _feed.last_seq();
+	}
+
+	/**
+		@return sequenza dell'ultima modifica registrata
+	*/
+	std::uint64_t last_seq() const {
+		return _feed.last_seq();
+	}
+
+private:
+	Map<C, V, Eq, H> _map; // contenuto corrente
+	ChangeFeed<C, V> _feed; // ultime modifiche
+};
+
+#endif
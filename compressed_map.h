@@ -0,0 +1,199 @@
+#ifndef COMPRESSED_MAP_H
+#define COMPRESSED_MAP_H
+
+#include <string> // std::string
+#include <vector> // std::vector
+#include <utility> // std::move
+#include "map.h"
+#include "lz_codec.h"
+
+/**
+	@brief Classe CompressedMap
+
+	Mappa con valori di tipo stringa (o blob di byte) memorizzati in
+	forma compressa. Ogni valore viene compresso in add() dalla policy
+	Codec e decompresso alla lettura, scambiando un po' di CPU per
+	ricerca con una minore occupazione di memoria quando i valori sono
+	grandi o ripetitivi.
+
+	La policy Codec deve fornire:
+	- void compress(const char *src, std::size_t n, std::string &out) const
+	- void decompress(const char *src, std::size_t n, std::string &out) const
+	- static std::size_t raw_size(const char *src, std::size_t n)
+
+	Il codec di default è LzCodec; per valori brevi e simili tra loro
+	conviene costruirlo con un dizionario ottenuto da LzCodec::train su
+	un campione dei valori.
+
+	I valori si leggono decompressi in un buffer del chiamante, oppure
+	tramite una piccola cache dei valori decompressi più recenti. Le
+	letture tramite cache modificano la cache, per cui a differenza di
+	Map anche le letture concorrenti devono essere sincronizzate; value
+	con buffer del chiamante può invece essere usata da più thread.
+*/
+template <typename C, typename Eq, typename H = no_hash<C>, typename Codec = LzCodec>
+class CompressedMap {
+public:
+	/**
+		Costruttore
+
+		@param codec codec usato per comprimere i valori
+		@param cache_size numero di valori decompressi mantenuti in cache
+	*/
+	explicit CompressedMap(const Codec &codec = Codec(), unsigned int cache_size = 8)
+		: _codec(codec), _cache(cache_size), _next(0), _raw_bytes(0), _compressed_bytes(0) {}
+
+	/**
+		@brief Aggiunge una coppia alla mappa comprimendone il valore.
+
+		@param k chiave della coppia
+		@param v valore della coppia
+		@throw keyAlreadyDefinedException se la chiave è già presente
+	*/
+	void add(const C &k, const std::string &v) {
+		_codec.compress(v.data(), v.size(), _scratch);
+		// Copia con capacità esatta: il buffer di lavoro resta allocato
+		// per le compressioni successive
+		_map.add(k, std::string(_scratch));
+		_raw_bytes += v.size();
+		_compressed_bytes += _scratch.size();
+	}
+
+	/**
+		@brief Rimuove una coppia dalla mappa.
+
+		@param key chiave della coppia
+		@throw keyNotFoundException se la chiave non è presente
+	*/
+	void remove(const C &key) {
+		typename Map<C, std::string, Eq, H>::const_iterator i = _map.find(key);
+		if (i == _map.end())
+			throw keyNotFoundException("Chiave non trovata nella mappa.");
+
+		const std::string &blob = i->value;
+		_raw_bytes -= Codec::raw_size(blob.data(), blob.size());
+		_compressed_bytes -= blob.size();
+
+		for (CacheEntry &e : _cache)
+			if (e.valid && _equals(e.key, key))
+				e.valid = false;
+
+		_map.remove(key);
+	}
+
+	/**
+		@brief Verifica l'esistenza di una coppia nella mappa.
+	*/
+	bool exists(const C &key) const {
+		return _map.exists(key);
+	}
+
+	/**
+		@brief Decomprime il valore associato ad una chiave in un buffer
+		del chiamante.
+
+		Riusando lo stesso buffer per più letture si evita di allocare
+		memoria ad ogni chiamata.
+
+		@param key chiave della coppia
+		@param out buffer in cui scrivere il valore
+		@throw keyNotFoundException se la chiave non è presente
+	*/
+	void value(const C &key, std::string &out) const {
+		const std::string &blob = _map.value(key);
+		_codec.decompress(blob.data(), blob.size(), out);
+	}
+
+	/**
+		@brief Restituisce il valore associato ad una chiave tramite la
+		cache dei valori decompressi.
+
+		Se il valore non è in cache viene decompresso al posto della voce
+		inserita da più tempo (sostituzione a rotazione, FIFO: una lettura
+		dalla cache non rinnova la voce). Il riferimento restituito resta
+		valido fino alla successiva chiamata non costante o di questa
+		funzione.
+
+		@param key chiave della coppia
+		@return il valore decompresso
+		@throw keyNotFoundException se la chiave non è presente
+	*/
+	const std::string &value(const C &key) const {
+		for (CacheEntry &e : _cache)
+			if (e.valid && _equals(e.key, key))
+				return e.value;
+
+		const std::string &blob = _map.value(key);
+		if (_cache.empty()) {
+			_codec.decompress(blob.data(), blob.size(), _scratch);
+			return _scratch;
+		}
+
+		CacheEntry &e = _cache[_next];
+		_next = (_next + 1) % _cache.size();
+		e.valid = false;
+		_codec.decompress(blob.data(), blob.size(), e.value);
+		e.key = key;
+		e.valid = true;
+		return e.value;
+	}
+
+	/**
+		@return numero di coppie presenti nella mappa
+	*/
+	unsigned int size() const {
+		return _map.size();
+	}
+
+	/**
+		@return somma delle dimensioni dei valori non compressi
+	*/
+	std::size_t raw_bytes() const {
+		return _raw_bytes;
+	}
+
+	/**
+		@return somma delle dimensioni dei valori compressi
+	*/
+	std::size_t compressed_bytes() const {
+		return _compressed_bytes;
+	}
+
+	/**
+		@return occupazione di memoria della mappa sottostante (valori
+		compressi, esclusi cache e dizionario)
+	*/
+	MemoryUsage memory_usage() const {
+		return _map.memory_usage();
+	}
+
+	/**
+		@return la mappa con i valori compressi, per l'accesso in lettura
+	*/
+	const Map<C, std::string, Eq, H> &map() const {
+		return _map;
+	}
+
+private:
+	/**
+		Voce della cache dei valori decompressi
+	*/
+	struct CacheEntry {
+		bool valid;
+		C key;
+		std::string value;
+
+		CacheEntry() : valid(false), key() {}
+	};
+
+	Map<C, std::string, Eq, H> _map; // valori compressi
+	Codec _codec; // policy di compressione
+	Eq _equals; // confronto tra chiavi per la cache
+	mutable std::vector<CacheEntry> _cache; // valori decompressi recenti
+	mutable unsigned int _next; // prossima voce della cache da sostituire
+	mutable std::string _scratch; // buffer di lavoro
+	std::size_t _raw_bytes; // dimensione totale dei valori originali
+	std::size_t _compressed_bytes; // dimensione totale dei valori compressi
+};
+
+#endif
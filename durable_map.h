@@ -0,0 +1,601 @@
+#ifndef DURABLE_MAP_H
+#define DURABLE_MAP_H
+
+#include <string> // std::string
+#include <cstring> // std::memcpy
+#include <cstdint> // std::uint32_t, std::uint64_t
+#include <array> // std::array
+#include <type_traits> // std::is_trivially_copyable
+#include <cerrno> // errno
+#include <fcntl.h> // ::open
+#include <unistd.h> // ::write, ::fsync, ::ftruncate
+#include <sys/stat.h> // ::mkdir, ::fstat
+#include <cstdio> // std::rename
+#include "map.h"
+#include "io_exception.h" // eccezione custom per gli errori su file
+
+/**
+	@brief Codifica binaria di default per chiavi e valori di DurableMap
+
+	I tipi trivially copyable vengono scritti così come sono in memoria,
+	le stringhe come lunghezza (32 bit) seguita dai caratteri. Per altri
+	tipi è possibile fornire a DurableMap una codifica con la stessa
+	interfaccia.
+*/
+struct binary_codec {
+	/**
+		Accoda a out la rappresentazione binaria di v
+	*/
+	template <typename T>
+	static void put(std::string &out, const T &v) {
+		static_assert(std::is_trivially_copyable<T>::value,
+			"binary_codec supporta solo tipi trivially copyable e std::string");
+		out.append(reinterpret_cast<const char *>(&v), sizeof(T));
+	}
+
+	static void put(std::string &out, const std::string &v) {
+		std::uint32_t n = static_cast<std::uint32_t>(v.size());
+		put(out, n);
+		out.append(v);
+	}
+
+	/**
+		Legge v a partire da p, avanzando p
+
+		@return false se i dati tra p ed end non sono sufficienti
+	*/
+	template <typename T>
+	static bool get(const char *&p, const char *end, T &v) {
+		if (static_cast<std::size_t>(end - p) < sizeof(T))
+			return false;
+		std::memcpy(&v, p, sizeof(T));
+		p += sizeof(T);
+		return true;
+	}
+
+	static bool get(const char *&p, const char *end, std::string &v) {
+		std::uint32_t n;
+		if (!get(p, end, n) || static_cast<std::size_t>(end - p) < n)
+			return false;
+		v.assign(p, n);
+		p += n;
+		return true;
+	}
+};
+
+/**
+	@brief CRC-32 (polinomio IEEE) di un blocco di memoria
+
+	Usato per riconoscere i record del log scritti solo in parte.
+
+	@param data blocco di memoria
+	@param n numero di byte
+	@return checksum del blocco
+*/
+inline std::uint32_t crc32(const char *data, std::size_t n) {
+	// Tabella calcolata a tempo di compilazione: nessuna inizializzazione
+	// a runtime da sincronizzare tra thread
+	static constexpr std::array<std::uint32_t, 256> table = [] {
+		std::array<std::uint32_t, 256> t{};
+		for (std::uint32_t i = 0; i < 256; ++i) {
+			std::uint32_t c = i;
+			for (int k = 0; k < 8; ++k)
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			t[i] = c;
+		}
+		return t;
+	}();
+
+	std::uint32_t c = 0xFFFFFFFFu;
+	for (std::size_t i = 0; i < n; ++i)
+		c = table[(c ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (c >> 8);
+	return c ^ 0xFFFFFFFFu;
+}
+
+/**
+	@brief Classe DurableMap
+
+	Involucro di una Map che ne rende persistente il contenuto in una
+	directory del filesystem locale.
+
+	Ogni add e remove viene scritta come record binario nel log
+	(write-ahead log, file "wal") prima di essere applicata alla mappa,
+	per cui un'operazione terminata sopravvive sempre al crash del
+	processo. Il livello di durabilità stabilisce quando viene eseguito
+	l'fsync, necessario per sopravvivere al crash del sistema: mai, a
+	gruppi di record ("group commit") o ad ogni operazione.
+	Periodicamente, o su richiesta, il contenuto della mappa viene
+	salvato in uno snapshot (file "snapshot") e il log viene svuotato.
+
+	Ogni record ha un numero di sequenza (LSN) crescente e lo snapshot
+	memorizza l'LSN dell'ultimo record che contiene: al riavvio viene
+	caricato lo snapshot e vengono rieseguiti solo i record successivi,
+	per cui il tempo di ripristino dipende dalla lunghezza del log e
+	non dal numero di coppie. Un record finale scritto solo in parte
+	(riconosciuto tramite CRC) viene scartato.
+
+	Se la scrittura di un record fallisce (es. disco pieno) i byte
+	scritti in parte vengono rimossi dal log e l'operazione non viene
+	applicata. Se non è possibile rimuoverli, o fallisce un fsync, la
+	mappa entra in uno stato di errore: le letture restano possibili,
+	ogni modifica lancia ioException e occorre riaprire la mappa.
+*/
+template <typename C, typename V, typename Eq, typename H = no_hash<C>, typename Codec = binary_codec>
+class DurableMap {
+public:
+	/**
+		Livelli di durabilità dei record del log
+	*/
+	enum durability {
+		none,  // write ad ogni operazione, nessun fsync (sopravvive al crash del processo)
+		group, // write ad ogni operazione, fsync a gruppi di record (group commit)
+		sync   // write e fsync ad ogni operazione (sopravvive al crash del sistema)
+	};
+
+	/**
+		Costruttore
+
+		Apre (o crea) la directory e ripristina il contenuto della
+		mappa dallo snapshot e dal log.
+
+		@param dir directory dei file della mappa
+		@param level livello di durabilità
+		@param group_size numero di record per fsync con livello group
+		@param checkpoint_every numero di record dopo cui viene eseguito
+		automaticamente un checkpoint (0 per disattivarlo)
+
+		@throw ioException se i file non possono essere aperti o sono
+		corrotti
+	*/
+	explicit DurableMap(const std::string &dir, durability level = group,
+		unsigned int group_size = 64, unsigned int checkpoint_every = 100000)
+		: _dir(dir), _level(level), _group_size(group_size ? group_size : 1),
+		_checkpoint_every(checkpoint_every), _fd(-1), _lsn(0), _grouped(0),
+		_logged(0), _offset(0), _failed(false) {
+		::mkdir(_dir.c_str(), 0755); // la directory può già esistere
+
+		recover();
+	}
+
+	/**
+		Distruttore
+
+		Sincronizza i record non ancora sincronizzati.
+	*/
+	~DurableMap() {
+		try {
+			commit();
+		} catch(...) {
+			// un distruttore non deve lanciare eccezioni
+		}
+		if (_fd >= 0)
+			::close(_fd);
+	}
+
+	/**
+		@brief Aggiunge una coppia alla mappa registrandola nel log.
+
+		@param k chiave della coppia
+		@param v valore della coppia
+
+		@throw keyAlreadyDefinedException se la chiave è già presente,
+		ioException se la scrittura del log fallisce (l'operazione non
+		viene applicata) o se fallisce il checkpoint automatico
+		(l'operazione è già applicata e registrata)
+	*/
+	void add(const C &k, const V &v) {
+		check_state();
+		if (_map.exists(k))
+			throw keyAlreadyDefinedException("Chiave già presente nella mappa.");
+
+		std::string &body = begin_record(op_add);
+		Codec::put(body, k);
+		Codec::put(body, v);
+		off_t start = log_record();
+
+		try {
+			_map.add_unchecked(k, v);
+		} catch(...) {
+			discard_record(start);
+			throw;
+		}
+		after_record();
+	}
+
+	/**
+		@brief Rimuove una coppia dalla mappa registrandolo nel log.
+
+		@param key chiave della coppia
+
+		@throw keyNotFoundException se la chiave non è presente,
+		ioException se la scrittura del log fallisce (l'operazione non
+		viene applicata) o se fallisce il checkpoint automatico
+		(l'operazione è già applicata e registrata)
+	*/
+	void remove(const C &key) {
+		check_state();
+		if (!_map.exists(key))
+			throw keyNotFoundException("Chiave non trovata nella mappa.");
+
+		std::string &body = begin_record(op_remove);
+		Codec::put(body, key);
+		off_t start = log_record();
+
+		try {
+			_map.remove(key);
+		} catch(...) {
+			discard_record(start);
+			throw;
+		}
+		after_record();
+	}
+
+	/**
+		@brief Verifica l'esistenza di una coppia nella mappa.
+
+		@param key chiave della coppia
+		@return true se la coppia è presente, false altrimenti
+	*/
+	bool exists(const C &key) const {
+		return _map.exists(key);
+	}
+
+	/**
+		@brief Restituisce il valore associato ad una chiave
+
+		@param key chiave della coppia
+		@return il valore associato alla chiave
+		@throw keyNotFoundException se la chiave non è presente
+	*/
+	const V& value(const C &key) const {
+		return _map.value(key);
+	}
+
+	/**
+		@return numero di coppie presenti nella mappa
+	*/
+	unsigned int size() const {
+		return _map.size();
+	}
+
+	/**
+		@return la mappa in memoria, per l'accesso in lettura
+	*/
+	const Map<C, V, Eq, H> &map() const {
+		return _map;
+	}
+
+	/**
+		@brief Sincronizza su disco i record scritti dall'ultimo fsync.
+
+		I record sono già stati scritti nel log da add e remove; con
+		livello none non viene eseguito alcun fsync.
+
+		@throw ioException se l'fsync fallisce (la mappa entra nello
+		stato di errore) o la mappa è già nello stato di errore
+	*/
+	void commit() {
+		check_state();
+		if (_grouped > 0 && _level != none && ::fsync(_fd) != 0) {
+			_failed = true;
+			throw ioException("Sincronizzazione del log fallita.");
+		}
+		_grouped = 0;
+	}
+
+	/**
+		@brief Salva uno snapshot della mappa e svuota il log.
+
+		Lo snapshot viene scritto in un file temporaneo, sincronizzato
+		e poi rinominato, per cui su disco è sempre presente uno snapshot
+		completo. Se il processo termina prima dello svuotamento del log,
+		i record già contenuti nello snapshot vengono riconosciuti dal
+		loro LSN e ignorati al ripristino.
+
+		@throw ioException se la scrittura fallisce o la mappa è nello
+		stato di errore
+	*/
+	void checkpoint() {
+		check_state();
+		std::string data("MAPSNAP1");
+		Codec::put(data, static_cast<std::uint64_t>(_lsn));
+		Codec::put(data, static_cast<std::uint64_t>(_map.size()));
+
+		const Map<C, V, Eq, H> &map = _map;
+		for (const Pair<C, V> &p : map) {
+			Codec::put(data, p.key);
+			Codec::put(data, p.value);
+		}
+		Codec::put(data, crc32(data.data(), data.size()));
+
+		std::string tmp = path("snapshot.tmp");
+		int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			throw ioException("Impossibile creare lo snapshot.");
+
+		bool ok = write_fd(fd, data.data(), data.size()) && ::fsync(fd) == 0;
+		::close(fd);
+
+		if (!ok || std::rename(tmp.c_str(), path("snapshot").c_str()) != 0)
+			throw ioException("Scrittura dello snapshot fallita.");
+		sync_dir();
+
+		// Lo snapshot contiene tutto: il log non serve più. Se lo
+		// svuotamento fallisce i suoi record restano validi e vengono
+		// ignorati al ripristino grazie al loro LSN
+		if (::ftruncate(_fd, 0) != 0)
+			throw ioException("Svuotamento del log fallito.");
+		_offset = 0;
+		_grouped = 0;
+		_logged = 0;
+		if (::fsync(_fd) != 0)
+			throw ioException("Svuotamento del log fallito.");
+	}
+
+	/**
+		@return true se la mappa è nello stato di errore e deve essere
+		riaperta per poter essere modificata
+	*/
+	bool failed() const {
+		return _failed;
+	}
+
+	/**
+		@return numero di record nel log dall'ultimo checkpoint
+	*/
+	unsigned int log_records() const {
+		return _logged;
+	}
+
+private:
+	// Tipi di record del log
+	enum op_type { op_add = 1, op_remove = 2 };
+
+	DurableMap(const DurableMap &other); // non copiabile
+	DurableMap& operator=(const DurableMap &other); // non assegnabile
+
+	// Percorso di un file nella directory della mappa
+	std::string path(const char *name) const {
+		return _dir + "/" + name;
+	}
+
+	// Inizia un record: restituisce il buffer in cui codificare il corpo
+	std::string &begin_record(op_type op) {
+		_body.clear();
+		Codec::put(_body, static_cast<std::uint64_t>(_lsn + 1));
+		Codec::put(_body, static_cast<unsigned char>(op));
+		return _body;
+	}
+
+	// Lancia un'eccezione se la mappa è nello stato di errore
+	void check_state() const {
+		if (_failed)
+			throw ioException("Log in stato di errore: riaprire la mappa.");
+	}
+
+	// Completa il record (lunghezza, CRC, corpo) e lo scrive nel log,
+	// sincronizzandolo se richiesto dal livello di durabilità, prima
+	// che la mappa venga modificata. In caso di errore il record viene
+	// rimosso dal log, così un'operazione fallita non viene mai
+	// rieseguita al ripristino.
+	// Restituisce la posizione del log in cui inizia il record
+	off_t log_record() {
+		_record.clear();
+		Codec::put(_record, static_cast<std::uint32_t>(_body.size()));
+		Codec::put(_record, crc32(_body.data(), _body.size()));
+		_record.append(_body);
+
+		off_t start = _offset;
+		if (!write_fd(_fd, _record.data(), _record.size())) {
+			discard_tail(start);
+			throw ioException("Scrittura del log fallita.");
+		}
+		_offset += static_cast<off_t>(_record.size());
+		_lsn++;
+		_grouped++;
+
+		if (_level == sync || (_level == group && _grouped >= _group_size)) {
+			if (::fsync(_fd) != 0) {
+				// I record precedenti del gruppo potrebbero essere
+				// persi: non si può più garantire la durabilità
+				discard_record(start);
+				_failed = true;
+				throw ioException("Sincronizzazione del log fallita.");
+			}
+			_grouped = 0;
+		}
+
+		return start;
+	}
+
+	// Rimuove dal log l'ultimo record scritto, iniziato in start
+	void discard_record(off_t start) {
+		discard_tail(start);
+		_offset = start;
+		_lsn--;
+		if (_grouped > 0)
+			_grouped--;
+	}
+
+	// Tronca il log in start; se non è possibile i byte successivi
+	// resterebbero nel log, per cui la mappa entra nello stato di errore
+	void discard_tail(off_t start) {
+		if (::ftruncate(_fd, start) != 0)
+			_failed = true;
+	}
+
+	// Operazioni successive all'applicazione del record alla mappa
+	void after_record() {
+		_logged++;
+
+		if (_checkpoint_every > 0 && _logged >= _checkpoint_every)
+			checkpoint();
+	}
+
+	// Scrive n byte su fd, ripetendo le write parziali
+	static bool write_fd(int fd, const char *data, std::size_t n) {
+		while (n > 0) {
+			ssize_t w = ::write(fd, data, n);
+			if (w < 0) {
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			data += w;
+			n -= static_cast<std::size_t>(w);
+		}
+		return true;
+	}
+
+	// Sincronizza la directory, rendendo persistente la rename
+	void sync_dir() {
+		int fd = ::open(_dir.c_str(), O_RDONLY);
+		if (fd >= 0) {
+			::fsync(fd);
+			::close(fd);
+		}
+	}
+
+	// Legge l'intero contenuto di un file (stringa vuota se non esiste)
+	static bool read_file(const std::string &name, std::string &out) {
+		out.clear();
+		int fd = ::open(name.c_str(), O_RDONLY);
+		if (fd < 0)
+			return errno == ENOENT;
+
+		char chunk[1 << 16];
+		ssize_t r;
+		while ((r = ::read(fd, chunk, sizeof(chunk))) != 0) {
+			if (r < 0) {
+				if (errno == EINTR)
+					continue;
+				::close(fd);
+				return false;
+			}
+			out.append(chunk, static_cast<std::size_t>(r));
+		}
+		::close(fd);
+		return true;
+	}
+
+	// Carica lo snapshot, se presente
+	void load_snapshot() {
+		std::string data;
+		if (!read_file(path("snapshot"), data))
+			throw ioException("Lettura dello snapshot fallita.");
+		if (data.empty())
+			return;
+
+		const char *p = data.data();
+		const char *end = p + data.size() - sizeof(std::uint32_t);
+		std::uint32_t crc;
+		std::uint64_t lsn, count;
+
+		if (data.size() < 8 + sizeof(crc) || data.compare(0, 8, "MAPSNAP1") != 0)
+			throw ioException("Snapshot corrotto.");
+		std::memcpy(&crc, end, sizeof(crc));
+		if (crc != crc32(data.data(), data.size() - sizeof(crc)))
+			throw ioException("Snapshot corrotto.");
+
+		p += 8;
+		if (!Codec::get(p, end, lsn) || !Codec::get(p, end, count))
+			throw ioException("Snapshot corrotto.");
+
+		// Le chiavi dello snapshot sono distinte per costruzione
+		for (std::uint64_t i = 0; i < count; ++i) {
+			C k;
+			V v;
+			if (!Codec::get(p, end, k) || !Codec::get(p, end, v))
+				throw ioException("Snapshot corrotto.");
+			_map.add_unchecked(k, v);
+		}
+		_lsn = lsn;
+	}
+
+	// Riesegue i record del log successivi allo snapshot
+	std::size_t replay_log(const std::string &data) {
+		const char *p = data.data();
+		const char *end = p + data.size();
+		const char *valid = p; // fine dell'ultimo record integro
+
+		while (true) {
+			std::uint32_t len, crc;
+			const char *q = p;
+			if (!Codec::get(q, end, len) || !Codec::get(q, end, crc) ||
+				static_cast<std::size_t>(end - q) < len || crc32(q, len) != crc)
+				break; // fine del log o record scritto solo in parte
+
+			const char *body = q;
+			const char *body_end = q + len;
+			std::uint64_t lsn;
+			unsigned char op;
+			C k;
+			if (!Codec::get(body, body_end, lsn) || !Codec::get(body, body_end, op) ||
+				!Codec::get(body, body_end, k))
+				throw ioException("Record del log corrotto.");
+
+			if (lsn > _lsn) {
+				if (op == op_add) {
+					V v;
+					if (!Codec::get(body, body_end, v))
+						throw ioException("Record del log corrotto.");
+					_map.add(k, v);
+				} else if (op == op_remove) {
+					_map.remove(k);
+				} else {
+					throw ioException("Record del log corrotto.");
+				}
+				_lsn = lsn;
+				_logged++;
+			}
+
+			p = body_end;
+			valid = p;
+		}
+
+		return static_cast<std::size_t>(valid - data.data());
+	}
+
+	// Ripristino all'apertura: snapshot, log, troncamento della coda
+	void recover() {
+		load_snapshot();
+
+		std::string log;
+		if (!read_file(path("wal"), log))
+			throw ioException("Lettura del log fallita.");
+
+		std::size_t valid;
+		try {
+			valid = replay_log(log);
+		} catch(keyAlreadyDefinedException &) {
+			throw ioException("Log non coerente con lo snapshot.");
+		} catch(keyNotFoundException &) {
+			throw ioException("Log non coerente con lo snapshot.");
+		}
+
+		_fd = ::open(path("wal").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+		if (_fd < 0)
+			throw ioException("Impossibile aprire il log.");
+
+		// Scarta l'eventuale record finale incompleto
+		if (valid != log.size() && ::ftruncate(_fd, static_cast<off_t>(valid)) != 0)
+			throw ioException("Troncamento del log fallito.");
+		_offset = static_cast<off_t>(valid);
+	}
+
+	Map<C, V, Eq, H> _map; // contenuto in memoria
+	std::string _dir; // directory dei file
+	durability _level; // livello di durabilità
+	unsigned int _group_size; // record per gruppo
+	unsigned int _checkpoint_every; // record tra due checkpoint automatici
+	int _fd; // file descriptor del log
+	std::uint64_t _lsn; // LSN dell'ultimo record
+	unsigned int _grouped; // record scritti dall'ultimo fsync
+	unsigned int _logged; // record nel log dall'ultimo checkpoint
+	off_t _offset; // fine dell'ultimo record completo nel log
+	bool _failed; // stato di errore (vedi la descrizione della classe)
+	std::string _record; // record da scrivere
+	std::string _body; // corpo del record in costruzione
+};
+
+#endif
@@ -0,0 +1,356 @@
+#ifndef HOT_KEYS_H
+#define HOT_KEYS_H
+
+#include <vector> // std::vector
+#include <cstdint> // std::uint32_t, std::uint64_t
+#include <mutex> // std::mutex, std::lock_guard
+#include <algorithm> // std::sort, std::min
+#include <type_traits> // std::is_same
+#include "map.h"
+
+namespace hot_keys_detail {
+	// Finalizzatore di splitmix64: distribuisce i bit dell'hash
+	inline std::uint64_t mix(std::uint64_t x) {
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9ULL;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111ebULL;
+		return x ^ (x >> 31);
+	}
+
+	// Generatore xorshift con stato per thread, usato per il campionamento
+	inline std::uint64_t random() {
+		thread_local std::uint64_t state = 0;
+		if (state == 0)
+			state = mix(reinterpret_cast<std::uintptr_t>(&state)) | 1;
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+}
+
+/**
+	@brief Classe CountMinSketch
+
+	Stima la frequenza delle chiavi con memoria fissa: depth righe di
+	width contatori, ogni chiave incrementa un contatore per riga e la
+	stima è il minimo tra essi. La stima non è mai inferiore al valore
+	reale e lo supera al più di circa N / width (N accessi totali).
+
+	Gli incrementi sono conservativi: vengono incrementati solo i
+	contatori pari al minimo, riducendo la sovrastima.
+*/
+class CountMinSketch {
+public:
+	/**
+		Costruttore
+
+		@param width contatori per riga (arrotondato ad una potenza di 2)
+		@param depth numero di righe
+	*/
+	CountMinSketch(std::size_t width, std::size_t depth) : _mask(1), _depth(depth ? depth : 1) {
+		while (_mask < width)
+			_mask <<= 1;
+		_counters.assign(_mask * _depth, 0);
+		_mask--;
+	}
+
+	/**
+		@brief Registra un accesso.
+
+		@param h hash della chiave
+		@return stima della frequenza della chiave dopo l'accesso
+	*/
+	std::uint32_t add(std::size_t h) {
+		std::uint32_t low = estimate(h);
+		for (std::size_t r = 0; r < _depth; ++r) {
+			std::uint32_t &c = _counters[slot(h, r)];
+			if (c == low)
+				c++;
+		}
+		return low + 1;
+	}
+
+	/**
+		@param h hash della chiave
+		@return stima della frequenza della chiave
+	*/
+	std::uint32_t estimate(std::size_t h) const {
+		std::uint32_t low = _counters[slot(h, 0)];
+		for (std::size_t r = 1; r < _depth; ++r)
+			low = std::min(low, _counters[slot(h, r)]);
+		return low;
+	}
+
+	/**
+		@brief Azzera tutti i contatori.
+	*/
+	void clear() {
+		std::fill(_counters.begin(), _counters.end(), 0);
+	}
+
+private:
+	// Posizione del contatore della riga r: ogni riga usa un hash diverso
+	std::size_t slot(std::size_t h, std::size_t r) const {
+		std::uint64_t x = hot_keys_detail::mix(h + 0x9e3779b97f4a7c15ULL * (r + 1));
+		return r * (_mask + 1) + (x & _mask);
+	}
+
+	std::vector<std::uint32_t> _counters; // depth righe di width contatori
+	std::size_t _mask; // width - 1
+	std::size_t _depth; // numero di righe
+};
+
+/**
+	@brief Struct HotKey
+
+	Chiave frequente restituita da top_keys.
+*/
+template <typename C>
+struct HotKey {
+	C key; // chiave
+	std::uint64_t count; // stima degli accessi (può essere superiore al valore reale)
+	std::uint64_t guaranteed; // accessi sicuramente avvenuti (limite inferiore, a meno del campionamento)
+};
+
+/**
+	@brief Classe SpaceSaving
+
+	Mantiene le capacity chiavi più frequenti con l'algoritmo
+	Space-Saving: una chiave non presente prende il posto di quella con
+	il conteggio minimo, ereditandone il conteggio come errore massimo.
+	Ogni chiave con frequenza superiore a N / capacity è sicuramente
+	presente.
+*/
+template <typename C, typename Eq>
+class SpaceSaving {
+public:
+	/**
+		Voce della struttura
+	*/
+	struct Entry {
+		C key;
+		std::size_t hash;
+		std::uint64_t count; // conteggio (sovrastimato al più di error)
+		std::uint64_t error; // conteggio ereditato dalla chiave sostituita
+	};
+
+	/**
+		Costruttore
+
+		@param capacity numero di chiavi mantenute (almeno 1)
+	*/
+	explicit SpaceSaving(std::size_t capacity) : _capacity(capacity ? capacity : 1) {
+		_entries.reserve(_capacity);
+	}
+
+	/**
+		@brief Registra un accesso.
+
+		@param key chiave
+		@param h hash della chiave, confrontato prima di Eq
+	*/
+	void add(const C &key, std::size_t h) {
+		std::size_t min = 0;
+		for (std::size_t i = 0; i < _entries.size(); ++i) {
+			Entry &e = _entries[i];
+			if (e.hash == h && _equals(e.key, key)) {
+				e.count++;
+				return;
+			}
+			if (e.count < _entries[min].count)
+				min = i;
+		}
+
+		if (_entries.size() < _capacity) {
+			_entries.push_back(Entry{key, h, 1, 0});
+			return;
+		}
+
+		Entry &e = _entries[min];
+		e.error = e.count;
+		e.count++;
+		e.key = key;
+		e.hash = h;
+	}
+
+	/**
+		@return le chiavi mantenute, in ordine non specificato
+	*/
+	const std::vector<Entry> &entries() const {
+		return _entries;
+	}
+
+	/**
+		@brief Rimuove tutte le chiavi.
+	*/
+	void clear() {
+		_entries.clear();
+	}
+
+private:
+	std::vector<Entry> _entries; // chiavi mantenute
+	std::size_t _capacity; // numero massimo di chiavi
+	Eq _equals; // confronto tra chiavi
+};
+
+/**
+	@brief Classe HotKeyMap
+
+	Involucro di una Map che registra le chiavi passate ad add, remove,
+	exists e value per individuare quelle più frequenti. Le chiavi
+	campionate alimentano un CountMinSketch e una struttura
+	SpaceSaving, entrambi di dimensione fissa; top_keys restituisce le
+	chiavi più frequenti con il minimo tra le due stime, più precisa di
+	ciascuna delle due.
+
+	Con sample_rate = n viene registrato in media un accesso su n
+	(scelto a caso) e i conteggi restituiti sono moltiplicati per n.
+	Il campionamento limita il costo dell'instrumentazione: gli accessi
+	non campionati costano solo un numero casuale, quelli campionati un
+	hash della chiave ed un lock.
+
+	Richiede un funtore di hash H. Come per Map, le letture possono
+	essere eseguite da più thread in parallelo (l'instrumentazione è
+	protetta da un mutex), mentre le modifiche vanno sincronizzate
+	esternamente.
+*/
+template <typename C, typename V, typename Eq, typename H>
+class HotKeyMap {
+	static_assert(!std::is_same<H, no_hash<C>>::value, "HotKeyMap richiede un funtore di hash per le chiavi");
+
+public:
+	/**
+		Costruttore
+
+		@param capacity chiavi frequenti mantenute (limite di top_keys)
+		@param sample_rate registra in media un accesso ogni sample_rate
+		@param width contatori per riga del CountMinSketch
+		@param depth righe del CountMinSketch
+	*/
+	explicit HotKeyMap(std::size_t capacity = 64, unsigned int sample_rate = 1,
+		std::size_t width = 1024, std::size_t depth = 4)
+		: _sketch(width, depth), _top(capacity), _rate(sample_rate ? sample_rate : 1),
+		_threshold(_rate == 1 ? 0 : UINT64_MAX / _rate), _sampled(0) {}
+
+	/**
+		@brief Aggiunge una coppia alla mappa.
+
+		@throw keyAlreadyDefinedException se la chiave è già presente
+	*/
+	void add(const C &k, const V &v) {
+		record(k);
+		_map.add(k, v);
+	}
+
+	/**
+		@brief Rimuove una coppia dalla mappa.
+
+		@throw keyNotFoundException se la chiave non è presente
+	*/
+	void remove(const C &key) {
+		record(key);
+		_map.remove(key);
+	}
+
+	/**
+		@brief Verifica l'esistenza di una coppia nella mappa.
+	*/
+	bool exists(const C &key) const {
+		record(key);
+		return _map.exists(key);
+	}
+
+	/**
+		@brief Restituisce il valore associato ad una chiave
+
+		@throw keyNotFoundException se la chiave non è presente
+	*/
+	const V& value(const C &key) const {
+		record(key);
+		return _map.value(key);
+	}
+
+	/**
+		@return numero di coppie presenti nella mappa
+	*/
+	unsigned int size() const {
+		return _map.size();
+	}
+
+	/**
+		@return la mappa, per l'accesso in lettura senza instrumentazione
+	*/
+	const Map<C, V, Eq, H> &map() const {
+		return _map;
+	}
+
+	/**
+		@brief Chiavi più frequenti.
+
+		@param k numero massimo di chiavi da restituire
+		@return le chiavi con più accessi, in ordine decrescente di count
+	*/
+	std::vector<HotKey<C>> top_keys(std::size_t k) const {
+		std::vector<HotKey<C>> result;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (const typename SpaceSaving<C, Eq>::Entry &e : _top.entries()) {
+				std::uint64_t count = std::min<std::uint64_t>(e.count, _sketch.estimate(e.hash));
+				result.push_back(HotKey<C>{e.key, count * _rate, (e.count - e.error) * _rate});
+			}
+		}
+
+		std::sort(result.begin(), result.end(), [](const HotKey<C> &a, const HotKey<C> &b) {
+			return a.count > b.count;
+		});
+		if (result.size() > k)
+			result.resize(k);
+		return result;
+	}
+
+	/**
+		@return numero di accessi registrati (prima della moltiplicazione
+		per il tasso di campionamento)
+	*/
+	std::uint64_t sampled() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _sampled;
+	}
+
+	/**
+		@brief Azzera le statistiche, ad esempio per misurare un nuovo
+		intervallo di tempo.
+	*/
+	void reset_stats() {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_sketch.clear();
+		_top.clear();
+		_sampled = 0;
+	}
+
+private:
+	// Registra l'accesso ad una chiave se viene campionato
+	void record(const C &key) const {
+		if (_threshold != 0 && hot_keys_detail::random() > _threshold)
+			return;
+
+		std::size_t h = _fhash(key);
+		std::lock_guard<std::mutex> lock(_mutex);
+		_sketch.add(h);
+		_top.add(key, h);
+		_sampled++;
+	}
+
+	Map<C, V, Eq, H> _map; // contenuto
+	H _fhash; // hash delle chiavi per le statistiche
+	mutable std::mutex _mutex; // protegge le statistiche
+	mutable CountMinSketch _sketch; // stima delle frequenze
+	mutable SpaceSaving<C, Eq> _top; // chiavi candidate
+	std::uint64_t _rate; // tasso di campionamento
+	std::uint64_t _threshold; // soglia del generatore (0: tutti gli accessi)
+	mutable std::uint64_t _sampled; // accessi registrati
+};
+
+#endif
@@ -0,0 +1,715 @@
+#ifndef INT_MAP_H
+#define INT_MAP_H
+
+#include <vector> // std::vector
+#include <cstdint> // std::uint64_t
+#include <cstddef> // std::size_t
+#include <bit> // std::popcount, std::countr_zero
+#include <type_traits> // std::is_integral, std::make_unsigned
+#include "key_not_found_exception.h" // eccezione custom per remove e value
+#include "key_already_defined_exception.h" // eccezione custom per add
+
+/**
+	@brief Classe IntMap
+
+	Mappa associativa specializzata per chiavi di tipo intero, con la
+	stessa interfaccia di base di Map (add, remove, exists, value, size,
+	clear, keys). La rappresentazione viene scelta automaticamente in
+	base alla densità delle chiavi:
+
+	- chiavi dense: array indirizzato direttamente dalla chiave (meno
+	  la chiave minima), con una bitmap di presenza. Una ricerca costa
+	  un controllo sulla bitmap ed una lettura dall'array.
+	- chiavi sparse: albero radix con una cifra di 8 bit per livello;
+	  i nodi interni passano da un array ordinato di al più 16 figli ad
+	  un array di 256 puntatori quando si riempiono, le foglie hanno una
+	  bitmap di 256 bit e i soli valori presenti, compattati.
+
+	Si passa alla rappresentazione densa quando almeno un quarto delle
+	chiavi comprese tra la minima e la massima è presente, e a quella
+	sparsa quando ne è presente meno di un ottavo (l'isteresi evita
+	conversioni ripetute). Il tipo V deve avere un costruttore di default.
+*/
+template <typename K, typename V>
+class IntMap {
+	static_assert(std::is_integral<K>::value, "IntMap richiede chiavi intere");
+
+	typedef typename std::make_unsigned<K>::type U;
+
+	// Numero di cifre di 8 bit della chiave, ovvero livelli dell'albero
+	static const int levels = sizeof(K);
+
+	// Soglie di densità (in reciproco) per il passaggio tra le due
+	// rappresentazioni
+	static const unsigned int to_dense = 4;
+	static const unsigned int to_sparse = 8;
+
+	/**
+		Foglia dell'albero radix: 256 chiavi consecutive
+	*/
+	struct Leaf {
+		std::uint64_t bits[4]; // bitmap di presenza
+		std::vector<V> vals; // valori presenti, in ordine di chiave
+
+		Leaf() : bits{0, 0, 0, 0} {}
+	};
+
+	/**
+		Nodo interno dell'albero radix
+	*/
+	struct Inner {
+		unsigned int count; // numero di figli
+		unsigned char digit[16]; // cifre dei figli (ordinate), se full == nullptr
+		void *small[16]; // figli corrispondenti a digit
+		void **full; // 256 figli indicizzati per cifra, se allocato
+
+		Inner() : count(0), full(nullptr) {}
+
+		~Inner() { delete[] full; }
+	};
+
+	bool _dense; // rappresentazione corrente
+	unsigned int _size; // numero di coppie
+	U _min, _max; // estremi delle chiavi inserite (rappresentazione sparsa)
+
+	U _base; // chiave corrispondente all'indice 0 dell'array denso
+	std::vector<V> _dvals; // valori (rappresentazione densa)
+	std::vector<std::uint64_t> _dbits; // bitmap di presenza (rappresentazione densa)
+
+	void *_root; // radice dell'albero (rappresentazione sparsa)
+
+public:
+
+	/**
+		Costruttore di default
+
+		@post size() == 0
+	*/
+	IntMap() : _dense(true), _size(0), _min(0), _max(0), _base(0), _root(nullptr) {}
+
+	/**
+		Copy constructor
+
+		@param other mappa da copiare
+		@throw se l'allocazione delle risorse fallisce lancia un'eccezione
+	*/
+	IntMap(const IntMap &other)
+		: _dense(other._dense), _size(0), _min(other._min), _max(other._max),
+		_base(other._base), _dvals(other._dvals), _dbits(other._dbits), _root(nullptr) {
+		if (_dense) {
+			_size = other._size;
+			return;
+		}
+
+		try {
+			other.walk([this](U u, const V &v) { sparse_insert(u, v); });
+			_size = other._size;
+		} catch(...) {
+			destroy(_root, 0); // recovery degli errori
+			throw;
+		}
+	}
+
+	/**
+		Operatore di assegnamento
+
+		@param other mappa da copiare
+		@return reference alla mappa this
+	*/
+	IntMap& operator=(const IntMap &other) {
+		if (this != &other) {
+			IntMap temp(other);
+			std::swap(_dense, temp._dense);
+			std::swap(_size, temp._size);
+			std::swap(_min, temp._min);
+			std::swap(_max, temp._max);
+			std::swap(_base, temp._base);
+			_dvals.swap(temp._dvals);
+			_dbits.swap(temp._dbits);
+			std::swap(_root, temp._root);
+		}
+		return *this;
+	}
+
+	/**
+		Distruttore
+	*/
+	~IntMap() { clear(); }
+
+	/**
+		@return numero di coppie presenti nella mappa
+	*/
+	unsigned int size() const {
+		return _size;
+	}
+
+	/**
+		@return true se la mappa usa la rappresentazione densa
+	*/
+	bool dense() const {
+		return _dense;
+	}
+
+	/**
+		@brief Svuota la mappa.
+
+		@post size() == 0
+	*/
+	void clear() {
+		destroy(_root, 0);
+		_root = nullptr;
+		std::vector<V>().swap(_dvals);
+		std::vector<std::uint64_t>().swap(_dbits);
+		_dense = true;
+		_size = 0;
+	}
+
+	/**
+		@brief Aggiunge una coppia alla mappa.
+
+		@param k chiave della coppia
+		@param v valore della coppia
+
+		@throw keyAlreadyDefinedException se la chiave è già presente;
+		se l'allocazione delle risorse fallisce rilancia l'eccezione
+	*/
+	void add(const K &k, const V &v) {
+		if (exists(k))
+			throw keyAlreadyDefinedException("Chiave già presente nella mappa.");
+
+		U u = to_u(k);
+
+		if (_dense) {
+			if (!dense_fit(u)) {
+				make_sparse();
+				sparse_add(u, v);
+				return;
+			}
+			std::size_t i = static_cast<std::size_t>(u - _base);
+			_dvals[i] = v;
+			_dbits[i >> 6] |= std::uint64_t(1) << (i & 63);
+			_size++;
+			return;
+		}
+
+		sparse_add(u, v);
+
+		// Se le chiavi sono diventate abbastanza dense si passa all'array
+		if (static_cast<unsigned long long>(_max - _min) < static_cast<unsigned long long>(_size) * to_dense)
+			make_dense();
+	}
+
+	/**
+		@brief Verifica l'esistenza di una coppia nella mappa.
+
+		@param key chiave della coppia
+		@return true se la coppia è presente, false altrimenti
+	*/
+	bool exists(const K &key) const {
+		return find(to_u(key)) != nullptr;
+	}
+
+	/**
+		@brief Restituisce il valore associato ad una chiave
+
+		@param key chiave della coppia
+		@return il valore associato alla chiave
+		@throw keyNotFoundException se la chiave non è presente
+	*/
+	const V& value(const K &key) const {
+		const V *v = find(to_u(key));
+		if (v == nullptr)
+			throw keyNotFoundException("Chiave non trovata nella mappa.");
+		return *v;
+	}
+
+	/**
+		@brief Rimuove una coppia dalla mappa.
+
+		@param key chiave della coppia
+		@throw keyNotFoundException se la chiave non è presente
+	*/
+	void remove(const K &key) {
+		if (!exists(key))
+			throw keyNotFoundException("Chiave non trovata nella mappa.");
+
+		U u = to_u(key);
+
+		if (_dense) {
+			std::size_t i = static_cast<std::size_t>(u - _base);
+			_dbits[i >> 6] &= ~(std::uint64_t(1) << (i & 63));
+			_dvals[i] = V(); // libera le eventuali risorse del valore
+			_size--;
+
+			if (_size == 0)
+				clear();
+			else if (_dvals.size() > 64 && _size * to_sparse < _dvals.size())
+				make_sparse();
+			return;
+		}
+
+		if (erase(_root, 0, u)) {
+			destroy(_root, 0);
+			_root = nullptr;
+		}
+		_size--;
+
+		if (_size == 0) {
+			clear();
+			return;
+		}
+
+		// Gli estremi vengono aggiornati scendendo lungo il bordo dell'albero
+		if (u == _min)
+			_min = edge(false);
+		if (u == _max)
+			_max = edge(true);
+	}
+
+	/**
+		@brief Applica una funzione a tutte le coppie in ordine di chiave.
+
+		@param fn funzione invocata come fn(chiave, valore)
+	*/
+	template <typename F>
+	void for_each(F fn) const {
+		walk([&fn](U u, const V &v) { fn(from_u(u), v); });
+	}
+
+	/**
+		@brief Restituisce un vettore con le chiavi in ordine crescente.
+
+		@return std::vector<K>
+	*/
+	std::vector<K> keys() const {
+		std::vector<K> v;
+		v.reserve(_size);
+		walk([&v](U u, const V &) { v.push_back(from_u(u)); });
+		return v;
+	}
+
+private:
+
+	// Trasforma la chiave in un intero senza segno mantenendo l'ordine
+	static U to_u(K k) {
+		return static_cast<U>(static_cast<U>(k) ^ sign_flip());
+	}
+
+	static K from_u(U u) {
+		return static_cast<K>(static_cast<U>(u ^ sign_flip()));
+	}
+
+	static U sign_flip() {
+		if (std::is_signed<K>::value)
+			return static_cast<U>(U(1) << (sizeof(K) * 8 - 1));
+		return 0;
+	}
+
+	// Cifra di 8 bit della chiave al livello dato (0 = più significativa)
+	static unsigned char digit(U u, int level) {
+		return static_cast<unsigned char>(u >> (8 * (levels - 1 - level)));
+	}
+
+	// Ricerca del valore, nullptr se assente
+	const V *find(U u) const {
+		if (_dense) {
+			std::size_t i = static_cast<std::size_t>(u - _base);
+			if (u < _base || i >= _dvals.size() || !(_dbits[i >> 6] & (std::uint64_t(1) << (i & 63))))
+				return nullptr;
+			return &_dvals[i];
+		}
+
+		void *node = _root;
+		for (int level = 0; level < levels - 1 && node != nullptr; ++level)
+			node = child(static_cast<Inner *>(node), digit(u, level));
+		if (node == nullptr)
+			return nullptr;
+
+		const Leaf *leaf = static_cast<const Leaf *>(node);
+		unsigned char d = digit(u, levels - 1);
+		if (!(leaf->bits[d >> 6] & (std::uint64_t(1) << (d & 63))))
+			return nullptr;
+		return &leaf->vals[rank(leaf, d)];
+	}
+
+	/**
+		Verifica se la chiave u può essere aggiunta all'array denso,
+		eventualmente estendendolo. L'array cresce almeno del doppio
+		(per ammortizzare le estensioni successive) ma senza scendere
+		sotto la densità minima.
+
+		L'array copre sempre chiavi comprese in [0, max U]: l'ultima
+		chiave coperta _base + size - 1 non supera mai la chiave massima.
+
+		@return false se la chiave renderebbe l'array troppo sparso
+	*/
+	bool dense_fit(U u) {
+		const U top = static_cast<U>(~U(0));
+		unsigned long long span = _dvals.size();
+
+		if (span == 0) {
+			// Prima finestra di 64 chiavi, spostata verso il basso se la
+			// chiave è tra le ultime 63 (U ha almeno 8 bit)
+			_base = static_cast<unsigned long long>(top - u) < 63 ? static_cast<U>(top - 63) : u;
+			_dvals.resize(64);
+			_dbits.assign(1, 0);
+			return true;
+		}
+
+		U hi = static_cast<U>(_base + (span - 1)); // non supera top
+		if (u >= _base && u <= hi)
+			return true;
+
+		unsigned long long limit = static_cast<unsigned long long>(_size + 1) * to_sparse;
+		// Distanze calcolate in U, senza overflow perché _base <= hi
+		unsigned long long needed = static_cast<unsigned long long>(u < _base ? U(hi - u) : U(u - _base));
+		if (needed >= limit)
+			return false;
+		needed++;
+
+		unsigned long long target = span * 2 < limit ? span * 2 : limit;
+		if (target < needed)
+			target = needed;
+
+		U lo;
+		if (u > hi) {
+			// Crescita verso l'alto, senza superare la chiave massima
+			lo = _base;
+			if (target - 1 > static_cast<unsigned long long>(top - _base))
+				target = static_cast<unsigned long long>(top - _base) + 1;
+		} else {
+			// Crescita verso il basso, senza scendere sotto 0
+			lo = (target - 1 <= static_cast<unsigned long long>(hi)) ? static_cast<U>(hi - (target - 1)) : U(0);
+			target = static_cast<unsigned long long>(hi - lo) + 1;
+		}
+
+		std::vector<V> vals(static_cast<std::size_t>(target));
+		std::vector<std::uint64_t> bits(static_cast<std::size_t>((target + 63) / 64), 0);
+		std::size_t shift = static_cast<std::size_t>(_base - lo);
+
+		for (std::size_t w = 0; w < _dbits.size(); ++w) {
+			for (std::uint64_t b = _dbits[w]; b != 0; b &= b - 1) {
+				std::size_t i = w * 64 + std::countr_zero(b);
+				std::size_t j = i + shift;
+				vals[j] = _dvals[i];
+				bits[j >> 6] |= std::uint64_t(1) << (j & 63);
+			}
+		}
+
+		_base = lo;
+		_dvals.swap(vals);
+		_dbits.swap(bits);
+		return true;
+	}
+
+	// Passaggio alla rappresentazione sparsa
+	void make_sparse() {
+		void *root = nullptr;
+		std::swap(root, _root);
+		std::size_t lo = 0, hi = 0; // posizioni della prima e dell'ultima chiave
+		bool first = true;
+
+		try {
+			for (std::size_t w = 0; w < _dbits.size(); ++w) {
+				for (std::uint64_t b = _dbits[w]; b != 0; b &= b - 1) {
+					std::size_t i = w * 64 + std::countr_zero(b);
+					sparse_insert(static_cast<U>(_base + i), _dvals[i]);
+					if (first)
+						lo = i;
+					hi = i;
+					first = false;
+				}
+			}
+		} catch(...) {
+			destroy(_root, 0); // la rappresentazione densa resta valida
+			_root = root;
+			throw;
+		}
+
+		// Estremi delle chiavi presenti, non dell'array: l'array può
+		// essere molto più ampio dopo le rimozioni
+		_min = static_cast<U>(_base + lo);
+		_max = static_cast<U>(_base + hi);
+		std::vector<V>().swap(_dvals);
+		std::vector<std::uint64_t>().swap(_dbits);
+		_dense = false;
+	}
+
+	// Passaggio alla rappresentazione densa
+	void make_dense() {
+		U lo = 0, hi = 0;
+		bool first = true;
+		walk([&](U u, const V &) {
+			if (first)
+				lo = u;
+			hi = u;
+			first = false;
+		});
+
+		std::size_t span = static_cast<std::size_t>(hi - lo) + 1;
+		std::vector<V> vals(span);
+		std::vector<std::uint64_t> bits((span + 63) / 64, 0);
+
+		walk([&](U u, const V &v) {
+			std::size_t i = static_cast<std::size_t>(u - lo);
+			vals[i] = v;
+			bits[i >> 6] |= std::uint64_t(1) << (i & 63);
+		});
+
+		destroy(_root, 0);
+		_root = nullptr;
+		_base = lo;
+		_dvals.swap(vals);
+		_dbits.swap(bits);
+		_dense = true;
+	}
+
+	// Aggiunta nella rappresentazione sparsa con aggiornamento degli estremi
+	void sparse_add(U u, const V &v) {
+		sparse_insert(u, v);
+		if (_size == 0 || u < _min)
+			_min = u;
+		if (_size == 0 || u > _max)
+			_max = u;
+		_size++;
+	}
+
+	// Posizione del valore della cifra d tra i valori compattati della foglia
+	static std::size_t rank(const Leaf *leaf, unsigned char d) {
+		std::size_t r = 0;
+		for (int w = 0; w < (d >> 6); ++w)
+			r += std::popcount(leaf->bits[w]);
+		return r + std::popcount(leaf->bits[d >> 6] & ((std::uint64_t(1) << (d & 63)) - 1));
+	}
+
+	// Figlio di un nodo interno per la cifra d (nullptr se assente)
+	static void *child(const Inner *in, unsigned char d) {
+		if (in->full != nullptr)
+			return in->full[d];
+		for (unsigned int i = 0; i < in->count; ++i) {
+			if (in->digit[i] == d)
+				return in->small[i];
+		}
+		return nullptr;
+	}
+
+	// Aggiunge un figlio ad un nodo interno
+	static void set_child(Inner *in, unsigned char d, void *c) {
+		if (in->full == nullptr && in->count == 16) {
+			void **full = new void *[256]();
+			for (unsigned int i = 0; i < 16; ++i)
+				full[in->digit[i]] = in->small[i];
+			in->full = full;
+		}
+
+		if (in->full != nullptr) {
+			in->full[d] = c;
+		} else {
+			// Inserimento ordinato, per visitare le chiavi in ordine
+			unsigned int i = in->count;
+			for (; i > 0 && in->digit[i - 1] > d; --i) {
+				in->digit[i] = in->digit[i - 1];
+				in->small[i] = in->small[i - 1];
+			}
+			in->digit[i] = d;
+			in->small[i] = c;
+		}
+		in->count++;
+	}
+
+	// Rimuove un figlio da un nodo interno
+	static void erase_child(Inner *in, unsigned char d) {
+		in->count--;
+
+		if (in->full != nullptr) {
+			in->full[d] = nullptr;
+
+			// Si torna all'array ordinato quando i figli sono pochi
+			if (in->count <= 12) {
+				unsigned int n = 0;
+				for (unsigned int i = 0; i < 256; ++i) {
+					if (in->full[i] != nullptr) {
+						in->digit[n] = static_cast<unsigned char>(i);
+						in->small[n] = in->full[i];
+						n++;
+					}
+				}
+				delete[] in->full;
+				in->full = nullptr;
+			}
+			return;
+		}
+
+		unsigned int i = 0;
+		while (in->digit[i] != d)
+			++i;
+		for (; i < in->count; ++i) {
+			in->digit[i] = in->digit[i + 1];
+			in->small[i] = in->small[i + 1];
+		}
+	}
+
+	// Crea un nodo del livello dato
+	static void *make_node(int level) {
+		if (level == levels - 1)
+			return new Leaf();
+		return new Inner();
+	}
+
+	// Inserisce una chiave (assente) nell'albero
+	void sparse_insert(U u, const V &v) {
+		if (_root == nullptr)
+			_root = make_node(0);
+
+		void *node = _root;
+		for (int level = 0; level < levels - 1; ++level) {
+			Inner *in = static_cast<Inner *>(node);
+			unsigned char d = digit(u, level);
+			void *c = child(in, d);
+
+			if (c == nullptr) {
+				c = make_node(level + 1);
+				try {
+					set_child(in, d, c);
+				} catch(...) {
+					destroy(c, level + 1);
+					throw;
+				}
+			}
+			node = c;
+		}
+
+		Leaf *leaf = static_cast<Leaf *>(node);
+		unsigned char d = digit(u, levels - 1);
+		leaf->vals.insert(leaf->vals.begin() + rank(leaf, d), v);
+		leaf->bits[d >> 6] |= std::uint64_t(1) << (d & 63);
+	}
+
+	/**
+		Rimuove una chiave (presente) dal sottoalbero di node
+
+		@return true se node è rimasto vuoto e deve essere deallocato
+	*/
+	static bool erase(void *node, int level, U u) {
+		unsigned char d = digit(u, level);
+
+		if (level == levels - 1) {
+			Leaf *leaf = static_cast<Leaf *>(node);
+			leaf->vals.erase(leaf->vals.begin() + rank(leaf, d));
+			leaf->bits[d >> 6] &= ~(std::uint64_t(1) << (d & 63));
+			return leaf->vals.empty();
+		}
+
+		Inner *in = static_cast<Inner *>(node);
+		void *c = child(in, d);
+		if (erase(c, level + 1, u)) {
+			destroy(c, level + 1);
+			erase_child(in, d);
+		}
+		return in->count == 0;
+	}
+
+	/**
+		Chiave minima (last == false) o massima (last == true)
+		dell'albero, che deve essere non vuoto
+	*/
+	U edge(bool last) const {
+		const void *node = _root;
+		U u = 0;
+
+		for (int level = 0; level < levels - 1; ++level) {
+			const Inner *in = static_cast<const Inner *>(node);
+			unsigned int d;
+
+			if (in->full != nullptr) {
+				d = last ? 255 : 0;
+				while (in->full[d] == nullptr)
+					d = last ? d - 1 : d + 1;
+				node = in->full[d];
+			} else {
+				unsigned int i = last ? in->count - 1 : 0;
+				d = in->digit[i];
+				node = in->small[i];
+			}
+			u = static_cast<U>(shift_in(u) | d);
+		}
+
+		const Leaf *leaf = static_cast<const Leaf *>(node);
+		unsigned int d = last ? 255 : 0;
+		while (!(leaf->bits[d >> 6] & (std::uint64_t(1) << (d & 63))))
+			d = last ? d - 1 : d + 1;
+		return static_cast<U>(shift_in(u) | d);
+	}
+
+	// Dealloca il sottoalbero di node
+	static void destroy(void *node, int level) {
+		if (node == nullptr)
+			return;
+
+		if (level == levels - 1) {
+			delete static_cast<Leaf *>(node);
+			return;
+		}
+
+		Inner *in = static_cast<Inner *>(node);
+		if (in->full != nullptr) {
+			for (unsigned int i = 0; i < 256; ++i)
+				destroy(in->full[i], level + 1);
+		} else {
+			for (unsigned int i = 0; i < in->count; ++i)
+				destroy(in->small[i], level + 1);
+		}
+		delete in;
+	}
+
+	// Visita in ordine di chiave di tutte le coppie
+	template <typename F>
+	void walk(F fn) const {
+		if (_dense) {
+			for (std::size_t w = 0; w < _dbits.size(); ++w) {
+				for (std::uint64_t b = _dbits[w]; b != 0; b &= b - 1) {
+					std::size_t i = w * 64 + std::countr_zero(b);
+					fn(static_cast<U>(_base + i), _dvals[i]);
+				}
+			}
+			return;
+		}
+		walk_node(_root, 0, 0, fn);
+	}
+
+	template <typename F>
+	static void walk_node(const void *node, int level, U prefix, F &fn) {
+		if (node == nullptr)
+			return;
+
+		if (level == levels - 1) {
+			const Leaf *leaf = static_cast<const Leaf *>(node);
+			std::size_t r = 0;
+			for (unsigned int w = 0; w < 4; ++w) {
+				for (std::uint64_t b = leaf->bits[w]; b != 0; b &= b - 1) {
+					U d = static_cast<U>(w * 64 + std::countr_zero(b));
+					fn(static_cast<U>(shift_in(prefix) | d), leaf->vals[r++]);
+				}
+			}
+			return;
+		}
+
+		const Inner *in = static_cast<const Inner *>(node);
+		if (in->full != nullptr) {
+			for (unsigned int i = 0; i < 256; ++i)
+				walk_node(in->full[i], level + 1, static_cast<U>(shift_in(prefix) | i), fn);
+		} else {
+			for (unsigned int i = 0; i < in->count; ++i)
+				walk_node(in->small[i], level + 1, static_cast<U>(shift_in(prefix) | in->digit[i]), fn);
+		}
+	}
+
+	// Sposta il prefisso di una cifra (evita lo shift di 8 bit su tipi di 8 bit)
+	static U shift_in(U prefix) {
+		if (levels == 1)
+			return 0;
+		return static_cast<U>(static_cast<unsigned long long>(prefix) << 8);
+	}
+};
+
+#endif
@@ -0,0 +1,7 @@
+#include "io_exception.h"
+
+ioException::ioException(const std::string &message) 
+	: std::runtime_error(message) {
+		// il messaggio è forwardato alla classe std::runtime_error 
+		// che a sua volta lo passerà alla classe std::exception
+	}
\ No newline at end of file
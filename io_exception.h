@@ -0,0 +1,19 @@
+#ifndef IO_EXCEPTION_H
+#define IO_EXCEPTION_H
+
+#include <stdexcept>
+#include <string>
+
+/**
+	Classe eccezione custom che deriva da std::runtime_error
+	per gli errori di lettura e scrittura su file
+*/
+class ioException : public std::runtime_error {
+public:
+	/**
+		Costruttore che prende un messaggio d'errore
+	*/
+	ioException(const std::string &message);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+#ifndef KEY_FUNCTORS_H
+#define KEY_FUNCTORS_H
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <cstring> // std::memcmp, std::memcpy
+#include <string> // std::string
+#include <type_traits> // std::is_trivially_copyable
+#if defined(__SSE2__)
+#include <emmintrin.h> // intrinseci SSE2
+#endif
+
+/**
+	@brief Confronto byte a byte di due blocchi di memoria.
+
+	Se disponibile SSE2 confronta 16 byte alla volta con una sola
+	istruzione di confronto e una maschera; il resto viene confrontato
+	a parole di 8 byte e infine byte per byte.
+
+	@param a primo blocco
+	@param b secondo blocco
+	@param n numero di byte da confrontare
+	@return true se i due blocchi sono uguali
+*/
+inline bool bytes_equal(const void *a, const void *b, std::size_t n) {
+	const unsigned char *pa = static_cast<const unsigned char *>(a);
+	const unsigned char *pb = static_cast<const unsigned char *>(b);
+
+#if defined(__SSE2__)
+	for (; n >= 16; n -= 16, pa += 16, pb += 16) {
+		__m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pa));
+		__m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pb));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) != 0xFFFF)
+			return false;
+	}
+#endif
+
+	for (; n >= 8; n -= 8, pa += 8, pb += 8) {
+		std::uint64_t wa, wb;
+		std::memcpy(&wa, pa, 8);
+		std::memcpy(&wb, pb, 8);
+		if (wa != wb)
+			return false;
+	}
+
+	for (; n > 0; --n, ++pa, ++pb) {
+		if (*pa != *pb)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+	@brief Hash di un blocco di memoria.
+
+	Elabora parole di 8 byte con una moltiplicazione e una rotazione
+	per parola, sufficiente a distinguere chiavi diverse nel confronto
+	preliminare della mappa.
+
+	@param p blocco di memoria
+	@param n numero di byte
+	@return valore di hash
+*/
+inline std::size_t bytes_hash(const void *p, std::size_t n) {
+	const unsigned char *c = static_cast<const unsigned char *>(p);
+	const std::uint64_t k = 0x9E3779B97F4A7C15ULL;
+	std::uint64_t h = n * k;
+
+	for (; n >= 8; n -= 8, c += 8) {
+		std::uint64_t w;
+		std::memcpy(&w, c, 8);
+		h = (h ^ (w * k)) * k;
+		h ^= h >> 29;
+	}
+
+	std::uint64_t w = 0;
+	std::memcpy(&w, c, n);
+	h = (h ^ (w * k)) * k;
+	h ^= h >> 32;
+
+	return static_cast<std::size_t>(h);
+}
+
+/**
+	@brief Funtore di uguaglianza per chiavi POD di dimensione fissa.
+
+	Confronta la rappresentazione in memoria delle chiavi, quindi il
+	tipo non deve avere byte di padding né campi in virgola mobile
+	(per i quali -0.0 == 0.0 ma le rappresentazioni differiscono).
+*/
+template <typename T>
+struct pod_equal {
+	static_assert(std::is_trivially_copyable<T>::value &&
+		std::has_unique_object_representations<T>::value,
+		"pod_equal richiede un tipo senza padding");
+
+	bool operator()(const T &a, const T &b) const {
+		return bytes_equal(&a, &b, sizeof(T));
+	}
+};
+
+/**
+	@brief Funtore di hash per chiavi POD di dimensione fissa.
+
+	Da usare insieme a pod_equal.
+*/
+template <typename T>
+struct pod_hash {
+	static_assert(std::is_trivially_copyable<T>::value &&
+		std::has_unique_object_representations<T>::value,
+		"pod_hash richiede un tipo senza padding");
+
+	std::size_t operator()(const T &k) const {
+		return bytes_hash(&k, sizeof(T));
+	}
+};
+
+/**
+	@brief Funtore di uguaglianza tra stringhe.
+
+	Confronta prima le lunghezze e poi i caratteri con bytes_equal.
+*/
+struct string_equal {
+	bool operator()(const std::string &a, const std::string &b) const {
+		return a.size() == b.size() && bytes_equal(a.data(), b.data(), a.size());
+	}
+};
+
+/**
+	@brief Funtore di hash per stringhe.
+
+	Da usare insieme a string_equal.
+*/
+struct string_hash {
+	std::size_t operator()(const std::string &k) const {
+		return bytes_hash(k.data(), k.size());
+	}
+};
+
+#endif
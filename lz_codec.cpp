@@ -0,0 +1,312 @@
+#include "lz_codec.h"
+#include <cstring> // std::memcpy
+#include <cstdint> // std::uint32_t, std::uint64_t
+#include <stdexcept> // std::runtime_error
+#include <unordered_map> // std::unordered_map
+#include <unordered_set> // std::unordered_set
+#include <algorithm> // std::sort
+
+namespace {
+	const int hash_bits = 12; // dimensione della tabella hash (2^12 voci)
+	const std::size_t min_match = 4; // lunghezza minima di un riferimento
+	const std::size_t max_offset = 65535; // finestra dei riferimenti
+	const std::size_t segment = 32; // lunghezza dei segmenti per train
+	const std::size_t gram = 8; // lunghezza dei gruppi contati da train
+
+	// Hash di 4 byte a partire da p
+	inline unsigned int hash4(const unsigned char *p) {
+		std::uint32_t v;
+		std::memcpy(&v, p, 4);
+		return (v * 2654435761u) >> (32 - hash_bits);
+	}
+
+	// Scrive una lunghezza di estensione (byte da 255 più un byte finale)
+	void put_ext(std::string &out, std::size_t n) {
+		for (; n >= 255; n -= 255)
+			out.push_back(static_cast<char>(255));
+		out.push_back(static_cast<char>(n));
+	}
+
+	// Scrive una sequenza di letterali seguita (se len > 0) da un riferimento
+	void put_sequence(std::string &out, const unsigned char *lit, std::size_t nlit,
+		std::size_t offset, std::size_t len) {
+		std::size_t m = len ? len - min_match : 0;
+		unsigned char token = static_cast<unsigned char>(((nlit < 15 ? nlit : 15) << 4) | (m < 15 ? m : 15));
+
+		out.push_back(static_cast<char>(token));
+		if (nlit >= 15)
+			put_ext(out, nlit - 15);
+		out.append(reinterpret_cast<const char *>(lit), nlit);
+
+		if (len == 0)
+			return;
+		out.push_back(static_cast<char>(offset & 0xFF));
+		out.push_back(static_cast<char>(offset >> 8));
+		if (m >= 15)
+			put_ext(out, m - 15);
+	}
+
+	// Tabella hash di lavoro di compress, una per thread. Le voci scritte
+	// durante una compressione sono marcate con la sua epoca; le altre
+	// valgono come la tabella precalcolata del dizionario, che così non
+	// viene copiata ad ogni chiamata
+	struct Scratch {
+		struct Entry {
+			int pos; // ultima posizione con questo hash
+			std::uint32_t epoch; // compressione che ha scritto la voce
+		};
+
+		std::vector<Entry> table;
+		std::uint32_t epoch;
+
+		Scratch() : table(std::size_t(1) << hash_bits, Entry{-1, 0}), epoch(0) {}
+
+		// Inizia una nuova compressione
+		void next() {
+			if (++epoch == 0) {
+				// Epoca ricominciata da capo: le vecchie marcature
+				// non devono essere scambiate per quelle nuove
+				for (Entry &e : table)
+					e.epoch = 0;
+				epoch = 1;
+			}
+		}
+	};
+
+	thread_local Scratch scratch;
+
+	// Legge una lunghezza di estensione
+	std::size_t get_ext(const unsigned char *&p, const unsigned char *end) {
+		std::size_t n = 0;
+		unsigned char b;
+		do {
+			if (p == end)
+				throw std::runtime_error("Dati compressi corrotti.");
+			b = *p++;
+			n += b;
+		} while (b == 255);
+		return n;
+	}
+}
+
+LzCodec::LzCodec() : _dict_table(1 << hash_bits, -1) {}
+
+LzCodec::LzCodec(const std::string &dict) : _dict_table(1 << hash_bits, -1) {
+	// I riferimenti non possono superare la finestra di 64 KB
+	_dict = dict.size() > max_offset ? dict.substr(dict.size() - max_offset) : dict;
+
+	const unsigned char *d = reinterpret_cast<const unsigned char *>(_dict.data());
+	for (std::size_t i = 0; i + min_match <= _dict.size(); ++i)
+		_dict_table[hash4(d + i)] = static_cast<int>(i);
+}
+
+const std::string &LzCodec::dictionary() const {
+	return _dict;
+}
+
+void LzCodec::compress(const char *src, std::size_t n, std::string &out) const {
+	const unsigned char *in = reinterpret_cast<const unsigned char *>(src);
+	const unsigned char *dict = reinterpret_cast<const unsigned char *>(_dict.data());
+	const std::size_t dn = _dict.size();
+
+	out.clear();
+	out.reserve(n + n / 255 + 16);
+
+	// Lunghezza originale come varint
+	for (std::size_t v = n; ; v >>= 7) {
+		if (v < 0x80) {
+			out.push_back(static_cast<char>(v));
+			break;
+		}
+		out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+	}
+
+	// Le posizioni sono "virtuali": [0, dn) nel dizionario, [dn, dn + n)
+	// nell'input, così i riferimenti possono attraversare il confine
+	Scratch &table = scratch;
+	table.next();
+	std::size_t anchor = 0; // inizio dei letterali non ancora scritti
+	std::size_t i = 0;
+
+	while (n >= min_match && i + min_match <= n) {
+		unsigned int h = hash4(in + i);
+		Scratch::Entry &e = table.table[h];
+		int cand = e.epoch == table.epoch ? e.pos : _dict_table[h];
+		e.pos = static_cast<int>(dn + i);
+		e.epoch = table.epoch;
+
+		std::size_t pos = dn + i;
+		if (cand < 0 || pos - static_cast<std::size_t>(cand) > max_offset) {
+			i++;
+			continue;
+		}
+
+		// Verifica ed estensione del riferimento
+		std::size_t c = static_cast<std::size_t>(cand);
+		std::size_t len = 0;
+		while (i + len < n) {
+			std::size_t cp = c + len;
+			unsigned char cb = cp < dn ? dict[cp] : in[cp - dn];
+			if (cb != in[i + len])
+				break;
+			len++;
+		}
+
+		if (len < min_match) {
+			i++;
+			continue;
+		}
+
+		put_sequence(out, in + anchor, i - anchor, pos - c, len);
+		i += len;
+		anchor = i;
+	}
+
+	put_sequence(out, in + anchor, n - anchor, 0, 0);
+}
+
+std::size_t LzCodec::raw_size(const char *src, std::size_t n) {
+	const unsigned char *p = reinterpret_cast<const unsigned char *>(src);
+	std::uint64_t size = 0;
+
+	// Al più 10 byte (70 bit) per un valore a 64 bit; il decimo byte
+	// può contribuire solo con il bit più alto
+	for (int shift = 0; n > 0 && shift < 70; shift += 7, --n, ++p) {
+		if (shift == 63 && (*p & 0x7E))
+			break;
+		size |= static_cast<std::uint64_t>(*p & 0x7F) << shift;
+		if (!(*p & 0x80)) {
+			if (size > static_cast<std::uint64_t>(SIZE_MAX))
+				break;
+			return static_cast<std::size_t>(size);
+		}
+	}
+	throw std::runtime_error("Dati compressi corrotti.");
+}
+
+void LzCodec::decompress(const char *src, std::size_t n, std::string &out) const {
+	const unsigned char *p = reinterpret_cast<const unsigned char *>(src);
+	const unsigned char *end = p + n;
+	const std::size_t dn = _dict.size();
+	std::size_t size = raw_size(src, n);
+
+	// Ogni byte compresso produce al più 255 byte (estensione della
+	// lunghezza di un riferimento): una lunghezza maggiore indica dati
+	// corrotti e non deve provocare un'allocazione enorme
+	if (size / 255 > n)
+		throw std::runtime_error("Dati compressi corrotti.");
+
+	while (*p & 0x80)
+		++p;
+	++p;
+
+	out.clear();
+	out.reserve(size);
+
+	while (true) {
+		if (p == end)
+			throw std::runtime_error("Dati compressi corrotti.");
+		unsigned char token = *p++;
+
+		std::size_t nlit = token >> 4;
+		if (nlit == 15)
+			nlit += get_ext(p, end);
+		if (static_cast<std::size_t>(end - p) < nlit || out.size() + nlit > size)
+			throw std::runtime_error("Dati compressi corrotti.");
+		out.append(reinterpret_cast<const char *>(p), nlit);
+		p += nlit;
+
+		if (out.size() == size)
+			return; // l'ultima sequenza contiene solo letterali
+
+		if (end - p < 2)
+			throw std::runtime_error("Dati compressi corrotti.");
+		std::size_t offset = p[0] | (static_cast<std::size_t>(p[1]) << 8);
+		p += 2;
+
+		std::size_t len = token & 0x0F;
+		if (len == 15)
+			len += get_ext(p, end);
+		len += min_match;
+
+		std::size_t pos = dn + out.size();
+		if (offset == 0 || offset > pos || out.size() + len > size)
+			throw std::runtime_error("Dati compressi corrotti.");
+
+		// Copia byte per byte: il riferimento può sovrapporsi ai byte
+		// che sta producendo o iniziare nel dizionario
+		std::size_t from = pos - offset;
+		for (std::size_t k = 0; k < len; ++k, ++from)
+			out.push_back(from < dn ? _dict[from] : out[from - dn]);
+	}
+}
+
+std::string LzCodec::train(const std::vector<std::string> &samples, std::size_t size) {
+	if (size > max_offset)
+		size = max_offset;
+
+	// Numero di valori in cui compare ogni gruppo di 8 byte
+	std::unordered_map<std::uint64_t, unsigned int> freq;
+	for (const std::string &s : samples) {
+		std::unordered_set<std::uint64_t> seen;
+		for (std::size_t i = 0; i + gram <= s.size(); ++i) {
+			std::uint64_t g;
+			std::memcpy(&g, s.data() + i, gram);
+			if (seen.insert(g).second)
+				freq[g]++;
+		}
+	}
+
+	// Punteggio dei segmenti: somma delle frequenze dei loro gruppi
+	// (contando solo quelli comuni ad almeno due valori)
+	struct Candidate {
+		std::size_t sample, start, score;
+	};
+	std::vector<Candidate> cand;
+	for (std::size_t s = 0; s < samples.size(); ++s) {
+		const std::string &v = samples[s];
+		for (std::size_t start = 0; start + gram <= v.size(); start += segment) {
+			std::size_t score = 0;
+			std::size_t stop = std::min(v.size(), start + segment);
+			for (std::size_t i = start; i + gram <= stop; ++i) {
+				std::uint64_t g;
+				std::memcpy(&g, v.data() + i, gram);
+				unsigned int f = freq[g];
+				if (f > 1)
+					score += f;
+			}
+			if (score > 0)
+				cand.push_back(Candidate{s, start, score});
+		}
+	}
+
+	std::sort(cand.begin(), cand.end(), [](const Candidate &a, const Candidate &b) {
+		return a.score > b.score;
+	});
+
+	// Scelta dei segmenti migliori, evitando quelli già contenuti
+	std::string dict;
+	std::unordered_set<std::uint64_t> used;
+	for (const Candidate &c : cand) {
+		if (dict.size() >= size)
+			break;
+
+		const std::string &v = samples[c.sample];
+		std::size_t stop = std::min(v.size(), c.start + segment);
+		std::size_t fresh = 0;
+		for (std::size_t i = c.start; i + gram <= stop; ++i) {
+			std::uint64_t g;
+			std::memcpy(&g, v.data() + i, gram);
+			if (used.insert(g).second)
+				fresh++;
+		}
+		if (fresh == 0)
+			continue;
+
+		std::size_t take = std::min(stop - c.start, size - dict.size());
+		// I segmenti più utili vanno in fondo, più vicini ai valori
+		dict.insert(0, v, c.start, take);
+	}
+
+	return dict;
+}
@@ -0,0 +1,96 @@
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+#include <string> // std::string
+#include <vector> // std::vector
+#include <cstddef> // std::size_t
+
+/**
+	@brief Classe LzCodec
+
+	Compressore LZ77 veloce, con formato a sequenze simile a LZ4: ogni
+	sequenza è formata da un gruppo di byte letterali seguito da un
+	riferimento (distanza, lunghezza) a byte già decodificati, entro una
+	finestra di 64 KB.
+
+	Il codec può usare un dizionario condiviso: i riferimenti possono
+	puntare anche al dizionario, che si comporta come se precedesse ogni
+	valore. Con valori brevi e ripetitivi (es. record con la stessa
+	struttura) il dizionario permette di comprimere anche valori che,
+	presi singolarmente, non contengono ripetizioni. Il dizionario può
+	essere ricavato da un insieme di valori di esempio con train().
+
+	Formato: lunghezza originale (varint), poi sequenze. Ogni sequenza
+	inizia con un byte: 4 bit alti per i letterali e 4 bit bassi per la
+	lunghezza del riferimento meno 4 (15 indica che seguono byte di
+	estensione da sommare, terminati da un byte minore di 255).
+	L'ultima sequenza contiene solo letterali.
+*/
+class LzCodec {
+public:
+	/**
+		Costruttore senza dizionario
+	*/
+	LzCodec();
+
+	/**
+		Costruttore con dizionario condiviso
+
+		@param dict dizionario (ne vengono usati al più gli ultimi 65535 byte)
+	*/
+	explicit LzCodec(const std::string &dict);
+
+	/**
+		@brief Comprime un blocco di byte.
+
+		@param src dati da comprimere
+		@param n numero di byte
+		@param out destinazione (il contenuto precedente viene sostituito)
+	*/
+	void compress(const char *src, std::size_t n, std::string &out) const;
+
+	/**
+		@brief Decomprime un blocco prodotto da compress con lo stesso
+		dizionario.
+
+		@param src dati compressi
+		@param n numero di byte compressi
+		@param out destinazione (il contenuto precedente viene sostituito)
+		@throw std::runtime_error se i dati sono corrotti
+	*/
+	void decompress(const char *src, std::size_t n, std::string &out) const;
+
+	/**
+		@brief Lunghezza originale di un blocco compresso.
+
+		@param src dati compressi
+		@param n numero di byte compressi
+		@return numero di byte dopo la decompressione
+	*/
+	static std::size_t raw_size(const char *src, std::size_t n);
+
+	/**
+		@brief Costruisce un dizionario da valori di esempio.
+
+		I valori vengono suddivisi in segmenti e vengono scelti i
+		segmenti che contengono più spesso gruppi di 8 byte presenti in
+		molti valori diversi, finché il dizionario non raggiunge la
+		dimensione richiesta.
+
+		@param samples valori di esempio
+		@param size dimensione massima del dizionario (al più 65535)
+		@return dizionario
+	*/
+	static std::string train(const std::vector<std::string> &samples, std::size_t size);
+
+	/**
+		@return il dizionario del codec
+	*/
+	const std::string &dictionary() const;
+
+private:
+	std::string _dict; // dizionario condiviso
+	std::vector<int> _dict_table; // tabella hash precalcolata sulle posizioni del dizionario
+};
+
+#endif
@@ -7,6 +7,26 @@
 #include <cassert>
 #include <string> // per std::string
 #include "map.h"
+#include "key_functors.h"
+#include "map_export.h"
+#include "durable_map.h"
+#include "int_map.h"
+#include "change_feed.h"
+#include "compressed_map.h"
+#include "hot_keys.h"
+#include "batch_writer.h"
+#include "multi_map.h"
+#include <thread> // std::thread
+#include <map> // std::map, riferimento per i test di IntMap
+#include <random> // std::mt19937
+#include <cstdlib> // mkdtemp
+#include <unistd.h> // fork, _exit
+#include <sys/wait.h> // waitpid
+#include <sys/resource.h> // setrlimit
+#include <csignal> // std::signal
+#include <fstream> // std::ofstream
+#include <cmath> // std::nan, HUGE_VAL
+#include <limits> // std::numeric_limits
 
 /**
   @brief Test metodi fondamentali struct pair
@@ -60,6 +80,17 @@ struct str_equal {
   }
 };
 
+/**
+  @brief Funtore di uguaglianza tra caratteri
+
+  Utilizzato nei confronti tra chiavi.
+*/
+struct char_equal {
+  bool operator()(char a, char b) const {
+    return a==b;
+  }
+};
+
 // Typedef per velocizzare test di una mappa con chiavi e valori di tipo
 // intero e relativo funtore per i confronti di uguaglianza
 typedef Map<int, int, int_equal> mapint;
@@ -408,6 +439,1083 @@ void test_eccezione_rimozione_chiave_non_presente() {
 	}
 }
 
+/**
+  @brief Test delle operazioni parallele della classe Map
+
+  Verifica che parallel_build, parallel_for_each e le versioni
+  parallele di keys e values producano gli stessi risultati delle
+  corrispondenti operazioni sequenziali.
+*/
+void test_operazioni_parallele() {
+	std::cout << "----------- Inizio test sulle operazioni parallele -----------" << std::endl;
+	ThreadPool pool(4);
+	mapint map1;
+
+	std::vector<Pair<int, int>> input;
+	for (int i = 0; i < 1000; ++i)
+		input.push_back(Pair<int, int>(i, i * 2));
+
+	map1.parallel_build(input.begin(), input.end(), pool);
+	assert(map1.size() == 1000);
+	assert(map1.value(500) == 1000);
+
+	// Stesso ordine di una sequenza di add
+	mapint map2;
+	for (int i = 0; i < 1000; ++i)
+		map2.add(i, i * 2);
+	assert(map1.keys() == map2.keys());
+	assert(map1.keys(pool) == map2.keys());
+	assert(map1.values(pool) == map2.values());
+
+	map1.parallel_for_each([](const int &k, int &v) { v += k; }, pool);
+	assert(map1.value(500) == 1500);
+
+	std::atomic<long> sum(0);
+	const mapint &cmap = map1;
+	cmap.parallel_for_each([&sum](const int &, const int &v) { sum += v; }, pool);
+	assert(sum == 3 * 999 * 1000 / 2);
+
+	// Una chiave ripetuta lascia la mappa invariata
+	std::vector<Pair<int, int>> dup;
+	dup.push_back(Pair<int, int>(2000, 1));
+	dup.push_back(Pair<int, int>(5, 1));
+	try {
+		map1.parallel_build(dup.begin(), dup.end(), pool);
+		assert(false);
+	} catch(keyAlreadyDefinedException &e) {
+		assert(map1.size() == 1000);
+		assert(map1.exists(2000) == false);
+	}
+
+	// Con un funtore di hash la verifica dei duplicati è partizionata
+	typedef Map<int, int, int_equal, pod_hash<int>> hashmap;
+	hashmap hmap;
+	hmap.add(-1, -1);
+	hmap.parallel_build(input.begin(), input.end(), pool);
+	assert(hmap.size() == 1001 && hmap.value(999) == 1998 && hmap.value(-1) == -1);
+	std::vector<int> expected_keys = map2.keys();
+	expected_keys.push_back(-1);
+	assert(hmap.keys() == expected_keys);
+	for (const std::vector<Pair<int, int>> &bad : {dup, std::vector<Pair<int, int>>{{3000, 0}, {3001, 0}, {3000, 1}}}) {
+		try {
+			hmap.parallel_build(bad.begin(), bad.end(), pool);
+			assert(false);
+		} catch(keyAlreadyDefinedException &e) {
+			assert(hmap.size() == 1001 && !hmap.exists(2000) && !hmap.exists(3000));
+		}
+	}
+
+	// Due thread sullo stesso pool: l'eccezione di uno non deve
+	// arrivare all'altro
+	for (int run = 0; run < 5; ++run) {
+		mapint failing(map2), built;
+		std::thread other([&failing, &pool]() {
+			try {
+				failing.parallel_for_each([](const int &, int &) { throw std::runtime_error("boom"); }, pool);
+				assert(false);
+			} catch(std::runtime_error &e) {}
+		});
+		built.parallel_build(input.begin(), input.end(), pool);
+		other.join();
+		assert(built.size() == 1000);
+	}
+
+	// Un task che non può essere accodato non resta in attesa nel
+	// gruppo: il distruttore non deve bloccarsi
+	{
+		bool armed = false;
+		struct copy_fails {
+			bool *armed;
+			explicit copy_fails(bool *a) : armed(a) {}
+			copy_fails(const copy_fails &other) : armed(other.armed) {
+				if (*armed)
+					throw std::runtime_error("copia fallita");
+			}
+			void operator()() const {}
+		};
+		ThreadPool::task t = copy_fails(&armed);
+		TaskGroup group(pool);
+		group.run([]() {});
+		armed = true;
+		try {
+			group.run(std::move(t));
+			assert(false);
+		} catch(std::runtime_error &e) {}
+		group.wait();
+	}
+
+	std::cout << "Chiavi raccolte in parallelo: " << map1.keys(pool).size() << std::endl;
+	std::cout << "----------- Fine test sulle operazioni parallele -----------" << std::endl;
+}
+
+/**
+  @brief Test dell'iteratore non costante e delle viste su chiavi e valori
+*/
+void test_viste() {
+	std::cout << "----------- Inizio test sulle viste di chiavi e valori -----------" << std::endl;
+	Map<std::string, int, str_equal> mapstr;
+	mapstr.add("uno", 1);
+	mapstr.add("due", 2);
+	mapstr.add("tre", 3);
+
+	// La vista sulle chiavi segue lo stesso ordine di keys()
+	std::vector<std::string> k = mapstr.keys();
+	std::vector<std::string> kv(mapstr.keys_view().begin(), mapstr.keys_view().end());
+	assert(k == kv);
+	assert(mapstr.keys_view().size() == 3);
+
+	std::cout << "Stampa delle chiavi tramite keys_view:" << std::endl;
+	for (const std::string &currkey : mapstr.keys_view()) {
+		std::cout << currkey << " ";
+	}
+	std::cout << std::endl;
+
+	// Modifica dei valori tramite la vista non costante
+	for (int &v : mapstr.values_view())
+		v *= 10;
+	assert(mapstr.value("due") == 20);
+
+	// Modifica dei valori tramite l'iteratore non costante
+	for (Map<std::string, int, str_equal>::iterator b = mapstr.begin(); b != mapstr.end(); ++b)
+		b->value += 1;
+	assert(mapstr.value("tre") == 31);
+
+	// La chiave non è modificabile tramite l'iteratore non costante
+	static_assert(std::is_same<decltype((mapstr.begin()->key)), const std::string &>::value,
+		"la chiave deve essere in sola lettura");
+	static_assert(std::is_same<decltype(((*mapstr.begin()).value)), int &>::value,
+		"il valore deve essere modificabile");
+
+	// Entrambi gli iteratori soddisfano i concept di C++20, per cui gli
+	// algoritmi di std::ranges funzionano anche sulla mappa non costante
+	typedef Map<std::string, int, str_equal> mapstrint;
+	static_assert(std::forward_iterator<mapstrint::iterator>, "iterator deve essere forward");
+	static_assert(std::forward_iterator<mapstrint::const_iterator>, "const_iterator deve essere forward");
+	static_assert(std::ranges::forward_range<mapstrint>, "la mappa deve essere un forward_range");
+	mapstrint::iterator due = std::ranges::find_if(mapstr, [](const Pair<std::string, int> &p) {
+		return p.key == "due";
+	});
+	assert(due != mapstr.end() && due->value == 21);
+	due->value = 22;
+	assert(mapstr.value("due") == 22);
+
+	// Compatibilità con gli algoritmi standard
+	const Map<std::string, int, str_equal> &cmap = mapstr;
+	assert(std::count_if(cmap.values_view().begin(), cmap.values_view().end(),
+		[](int v) { return v > 15; }) == 2);
+	assert(std::find(cmap.keys_view().begin(), cmap.keys_view().end(), "uno") != cmap.keys_view().end());
+
+	std::cout << "----------- Fine test sulle viste di chiavi e valori -----------" << std::endl;
+}
+
+/**
+  @brief Test delle operazioni insiemistiche tra mappe
+*/
+void test_operazioni_insiemistiche() {
+	std::cout << "----------- Inizio test sulle operazioni insiemistiche -----------" << std::endl;
+	mapint a, b;
+	a.add(1, 10);
+	a.add(2, 20);
+	a.add(3, 30);
+	b.add(3, 300);
+	b.add(4, 400);
+
+	// merge: la chiave 3 è in conflitto e resta in b
+	mapint c(a);
+	mapint d(b);
+	c.merge(d);
+	assert(c.size() == 4);
+	assert(c.value(3) == 30);
+	assert(c.value(4) == 400);
+	assert(d.size() == 1);
+	assert(d.value(3) == 300);
+
+	c.merge(mapint(b));
+	assert(c.size() == 4);
+
+	// unione con somma dei valori in conflitto
+	mapint u(a);
+	u.union_with(b, [](int, int x, int y) { return x + y; });
+	assert(u.size() == 4);
+	assert(u.value(3) == 330);
+	assert(u.value(4) == 400);
+
+	// intersezione mantenendo il valore di b
+	mapint i(a);
+	i.intersect_with(b, [](int, int, int y) { return y; });
+	assert(i.size() == 1);
+	assert(i.value(3) == 300);
+
+	// differenza
+	mapint df(a);
+	df.difference(b);
+	assert(df.size() == 2);
+	assert(df.exists(3) == false);
+	assert(df.exists(1) && df.exists(2));
+
+	// Un'eccezione di resolve lascia invariata la mappa unione
+	mapint ue(a);
+	try {
+		ue.union_with(b, [](int, int, int) -> int { throw std::runtime_error("conflitto"); });
+		assert(false);
+	} catch(std::runtime_error &e) {
+		assert(ue.size() == 3 && ue.value(3) == 30 && !ue.exists(4));
+	}
+
+	// Con funtore di hash le stesse operazioni usano un indice temporaneo
+	typedef Map<int, int, int_equal, pod_hash<int>> hashmap;
+	hashmap ha, hb;
+	for (int k = 0; k < 2000; ++k)
+		ha.add(k, k);
+	for (int k = 1000; k < 3000; ++k)
+		hb.add(k, 1);
+
+	hashmap hu(ha);
+	hu.union_with(hb, [](int, int x, int y) { return x + y; });
+	assert(hu.size() == 3000 && hu.value(1500) == 1501 && hu.value(2500) == 1 && hu.value(5) == 5);
+
+	hashmap hi(ha);
+	hi.intersect_with(hb, [](int, int x, int) { return -x; });
+	assert(hi.size() == 1000 && hi.value(1999) == -1999 && !hi.exists(999));
+
+	hashmap hd(ha);
+	hd.difference(hb);
+	assert(hd.size() == 1000 && hd.exists(999) && !hd.exists(1000));
+
+	// merge con indice: le chiavi in conflitto restano in other, anche
+	// quando other ha nodi preallocati che vengono copiati
+	hashmap hm(ha);
+	hashmap ho;
+	ho.reserve(500);
+	for (int k = 1000; k < 3000; ++k)
+		ho.add(k, -k);
+	hm.merge(ho);
+	assert(hm.size() == 3000 && ho.size() == 1000);
+	assert(hm.value(1999) == 1999 && hm.value(2000) == -2000 && hm.value(2999) == -2999);
+	assert(ho.exists(1000) && ho.exists(1999) && !ho.exists(2000));
+
+	std::cout << "Stampa della mappa unione:" << std::endl;
+	std::cout << u << std::endl;
+	std::cout << "----------- Fine test sulle operazioni insiemistiche -----------" << std::endl;
+}
+
+/**
+  @brief Test delle mappe con funtore di hash e dei funtori di confronto
+  vettorizzati
+*/
+void test_hash_e_confronti() {
+	std::cout << "----------- Inizio test su mappe con hash memorizzato nei nodi -----------" << std::endl;
+
+	// Confronti su blocchi di lunghezza diversa (parte SIMD, parole e coda)
+	std::string s1(37, 'x');
+	std::string s2(s1);
+	assert(bytes_equal(s1.data(), s2.data(), s1.size()));
+	s2[36] = 'y';
+	assert(!bytes_equal(s1.data(), s2.data(), s1.size()));
+	s2 = s1;
+	s2[3] = 'y';
+	assert(!bytes_equal(s1.data(), s2.data(), s1.size()));
+	assert(string_hash()(s1) == string_hash()(std::string(37, 'x')));
+
+	Map<std::string, int, string_equal, string_hash> mapstr;
+	mapstr.add("prova", 88);
+	mapstr.add("progetto", 94);
+	mapstr.add("anno", 2023);
+	assert(mapstr.exists("progetto"));
+	assert(mapstr.exists("progett") == false);
+	assert(mapstr.value("anno") == 2023);
+	mapstr.remove("prova");
+	assert(mapstr.size() == 2);
+
+	try {
+		mapstr.add("anno", 1);
+		assert(false);
+	} catch(keyAlreadyDefinedException &e) {
+		assert(mapstr.size() == 2);
+	}
+
+	Map<custom_obj, int, pod_equal<custom_obj>, pod_hash<custom_obj>> cusmap;
+	cusmap.add(custom_obj(4, 8), 55);
+	cusmap.add(custom_obj(23, 5), 35);
+	cusmap.add(custom_obj(8, 4), 9);
+	assert(cusmap.value(custom_obj(8, 4)) == 9);
+	assert(cusmap.exists(custom_obj(5, 23)) == false);
+
+	// L'hash memorizzato viene riusato dalle operazioni tra mappe
+	Map<custom_obj, int, pod_equal<custom_obj>, pod_hash<custom_obj>> other;
+	other.add(custom_obj(23, 5), 1);
+	other.add(custom_obj(1, 1), 2);
+	cusmap.union_with(other, [](const custom_obj &, int x, int y) { return x + y; });
+	assert(cusmap.size() == 4);
+	assert(cusmap.value(custom_obj(23, 5)) == 36);
+	cusmap.difference(other);
+	assert(cusmap.size() == 2);
+
+	std::cout << "Stampa delle coppie presenti in cusmap:" << std::endl;
+	std::cout << cusmap << std::endl;
+	std::cout << "----------- Fine test su mappe con hash memorizzato nei nodi -----------" << std::endl;
+}
+
+/**
+  @brief Test dell'esportazione massiva in CSV/TSV e JSON-lines
+*/
+void test_esportazione() {
+	std::cout << "----------- Inizio test sull'esportazione delle mappe -----------" << std::endl;
+	Map<std::string, double, str_equal> mapstr;
+	mapstr.add("b", 0.5);
+	mapstr.add("a,\"x\"", 2);
+
+	MapExporter exporter;
+	std::ostringstream csv;
+	exporter.csv(csv, mapstr);
+	assert(csv.str() == "\"a,\"\"x\"\"\",2\nb,0.5\n");
+
+	std::ostringstream tsv;
+	exporter.csv(tsv, mapstr, '\t');
+	assert(tsv.str() == "\"a,\"\"x\"\"\"\t2\nb\t0.5\n");
+
+	std::ostringstream json;
+	exporter.jsonl(json, mapstr);
+	assert(json.str() == "{\"key\":\"a,\\\"x\\\"\",\"value\":2}\n{\"key\":\"b\",\"value\":0.5}\n");
+
+	// Chiavi di tipo custom scritte tramite operator<<
+	Map<custom_obj, int, custom_obj_equal> cusmap;
+	cusmap.add(custom_obj(1, 2), 3);
+	std::ostringstream cus;
+	exporter.jsonl(cus, cusmap);
+	assert(cus.str() == "{\"key\":\"(first: 1 , second: 2)\",\"value\":3}\n");
+
+	// Valori non finiti scritti come null, char scritti come testo
+	Map<char, double, char_equal> charmap;
+	charmap.add('n', std::nan(""));
+	charmap.add('i', -HUGE_VAL);
+	charmap.add('"', 1.5);
+	std::ostringstream special;
+	exporter.jsonl(special, charmap);
+	assert(special.str() == "{\"key\":\"\\\"\",\"value\":1.5}\n{\"key\":\"i\",\"value\":null}\n"
+		"{\"key\":\"n\",\"value\":null}\n");
+	std::ostringstream charcsv;
+	exporter.csv(charcsv, charmap);
+	assert(charcsv.str() == "\"\"\"\",1.5\ni,-inf\nn,nan\n");
+
+	// Blocchi piccoli: il contenuto deve essere lo stesso, scritto in più parti
+	mapint map1;
+	for (int i = 0; i < 1000; ++i)
+		map1.add(i, -i);
+	MapExporter small(64);
+	std::string out;
+	int blocks = 0;
+	small.csv_to([&out, &blocks](const char *d, std::size_t n) { out.append(d, n); blocks++; }, map1);
+	std::ostringstream ref;
+	exporter.csv(ref, map1);
+	assert(out == ref.str());
+	assert(blocks > 1);
+
+	std::cout << "Esportazione TSV di mapstr:" << std::endl;
+	exporter.csv(1, mapstr, '\t');
+	std::cout << "----------- Fine test sull'esportazione delle mappe -----------" << std::endl;
+}
+
+/**
+  @brief Test della mappa persistente con log e snapshot
+*/
+void test_durable_map() {
+	std::cout << "----------- Inizio test sulla mappa persistente -----------" << std::endl;
+	char tmpl[] = "/tmp/durable_map_XXXXXX";
+	std::string dir = mkdtemp(tmpl);
+
+	typedef DurableMap<std::string, int, str_equal> durable;
+
+	{
+		durable dm(dir, durable::group, 4);
+		dm.add("uno", 1);
+		dm.add("due", 2);
+		dm.add("tre", 3);
+		dm.remove("due");
+		assert(dm.size() == 2);
+	}
+
+	// Ripristino dal solo log
+	{
+		durable dm(dir);
+		assert(dm.size() == 2);
+		assert(dm.value("tre") == 3);
+		assert(dm.exists("due") == false);
+		assert(dm.log_records() == 4);
+
+		dm.checkpoint();
+		assert(dm.log_records() == 0);
+		dm.add("quattro", 4);
+	}
+
+	// Ripristino da snapshot e coda del log, poi record finale incompleto
+	{
+		durable dm(dir, durable::sync);
+		assert(dm.size() == 3);
+		assert(dm.value("quattro") == 4);
+		assert(dm.log_records() == 1);
+	}
+	{
+		std::ofstream wal((dir + "/wal").c_str(), std::ios::app | std::ios::binary);
+		wal.write("\x20\x00\x00\x00garbage", 11);
+	}
+	{
+		durable dm(dir, durable::none, 64, 3);
+		assert(dm.size() == 3);
+		dm.add("cinque", 5);
+		dm.add("sei", 6); // terzo record: checkpoint automatico
+		assert(dm.log_records() == 0);
+	}
+	{
+		durable dm(dir);
+		assert(dm.size() == 5);
+		assert(dm.value("sei") == 6);
+		std::cout << "Contenuto ripristinato:" << std::endl;
+		std::cout << dm.map() << std::endl;
+	}
+
+	// Le operazioni terminate sopravvivono al crash del processo con
+	// ogni livello di durabilità
+	const durable::durability levels[] = {durable::none, durable::group, durable::sync};
+	for (durable::durability level : levels) {
+		std::remove((dir + "/wal").c_str());
+		std::remove((dir + "/snapshot").c_str());
+
+		pid_t pid = fork();
+		if (pid == 0) {
+			durable *dm = new durable(dir, level);
+			for (int i = 0; i < 10; ++i)
+				dm->add(std::to_string(i), i);
+			_exit(0); // nessun distruttore: simula il crash
+		}
+		int status;
+		waitpid(pid, &status, 0);
+
+		durable dm(dir, level);
+		assert(dm.size() == 10 && dm.value("9") == 9);
+	}
+
+	// Una scrittura fallita non lascia byte nel log e l'operazione non
+	// viene applicata: i record successivi restano recuperabili
+	{
+		std::remove((dir + "/wal").c_str());
+		std::remove((dir + "/snapshot").c_str());
+		durable dm(dir, durable::sync);
+		dm.add("a", 1);
+
+		struct rlimit old_limit, limit;
+		getrlimit(RLIMIT_FSIZE, &old_limit);
+		limit = old_limit;
+		limit.rlim_cur = 40; // il primo record occupa 26 byte
+		std::signal(SIGXFSZ, SIG_IGN);
+		setrlimit(RLIMIT_FSIZE, &limit);
+		try {
+			dm.add("grande", 2); // il record supera il limite: scritto in parte
+			assert(false);
+		} catch(ioException &e) {}
+		setrlimit(RLIMIT_FSIZE, &old_limit);
+		std::signal(SIGXFSZ, SIG_DFL);
+
+		assert(!dm.failed() && !dm.exists("grande"));
+		dm.add("b", 3);
+	}
+	{
+		durable dm(dir);
+		assert(dm.size() == 2 && dm.value("b") == 3 && !dm.exists("grande"));
+	}
+
+	std::remove((dir + "/wal").c_str());
+	std::remove((dir + "/snapshot").c_str());
+	std::remove(dir.c_str());
+	std::cout << "----------- Fine test sulla mappa persistente -----------" << std::endl;
+}
+
+/**
+  @brief Richiesta di primo livello usata da test_ricerca_asincrona
+
+  Cerca in sequenza le chiavi [first, last) e ne somma i valori.
+*/
+LookupTask<void> somma_valori(const mapint &map, int first, int last,
+	LookupScheduler &sched, int &sum, int &missing) {
+	for (int k = first; k < last; ++k) {
+		const int *v = co_await map.async_find(k, sched);
+		if (v != nullptr)
+			sum += *v;
+		else
+			missing++;
+	}
+}
+
+/**
+  @brief Test delle ricerche asincrone con coroutine
+*/
+void test_ricerca_asincrona() {
+	std::cout << "----------- Inizio test sulle ricerche asincrone -----------" << std::endl;
+	mapint map1;
+	for (int i = 0; i < 100; ++i)
+		map1.add(i, i * 3);
+
+	LookupScheduler sched;
+	int sums[4] = {0, 0, 0, 0};
+	int missing = 0;
+
+	// Quattro richieste interlacciate, l'ultima cerca anche chiavi assenti
+	sched.spawn(somma_valori(map1, 0, 25, sched, sums[0], missing));
+	sched.spawn(somma_valori(map1, 25, 50, sched, sums[1], missing));
+	sched.spawn(somma_valori(map1, 50, 75, sched, sums[2], missing));
+	sched.spawn(somma_valori(map1, 75, 110, sched, sums[3], missing));
+	sched.run();
+
+	int expected[4] = {0, 0, 0, 0};
+	for (int i = 0; i < 100; ++i)
+		expected[i / 25] += map1.value(i);
+
+	for (int i = 0; i < 4; ++i)
+		assert(sums[i] == expected[i]);
+	assert(missing == 10);
+
+	std::cout << "Somma dei valori trovati: " << sums[0] + sums[1] + sums[2] + sums[3] << std::endl;
+	std::cout << "----------- Fine test sulle ricerche asincrone -----------" << std::endl;
+}
+
+/**
+  @brief Verifica IntMap con chiavi agli estremi dell'intervallo del tipo K
+
+  Le chiavi vicine al massimo e al minimo vengono inserite in ordine
+  alterno, confrontando il risultato con std::map.
+*/
+template <typename K>
+void test_int_map_estremi() {
+	const K top = std::numeric_limits<K>::max();
+	const K bottom = std::numeric_limits<K>::min();
+	IntMap<K, long> im;
+	std::map<K, long> ref;
+
+	for (int i = 0; i < 70; ++i) {
+		K k = static_cast<K>(i % 2 == 0 ? top - i / 2 : bottom + i / 2);
+		im.add(k, i);
+		ref[k] = i;
+		assert(im.value(k) == i);
+	}
+	assert(im.size() == ref.size());
+	std::vector<K> keys = im.keys();
+	std::size_t i = 0;
+	for (typename std::map<K, long>::const_iterator b = ref.begin(); b != ref.end(); ++b, ++i) {
+		assert(keys[i] == b->first);
+		assert(im.value(b->first) == b->second);
+	}
+
+	// Solo chiavi in cima all'intervallo: l'array resta denso
+	IntMap<K, long> high;
+	for (int i = 0; i < 100; ++i)
+		high.add(static_cast<K>(top - 2 * i), i);
+	assert(high.dense() && high.value(top) == 0 && high.value(static_cast<K>(top - 198)) == 99);
+	assert(!high.exists(static_cast<K>(top - 1)) && !high.exists(bottom));
+}
+
+/**
+  @brief Test della mappa specializzata per chiavi intere
+
+  Verifica il passaggio automatico tra rappresentazione densa e sparsa
+  e confronta una sequenza casuale di operazioni con std::map.
+*/
+void test_int_map() {
+	std::cout << "----------- Inizio test sulla mappa con chiavi intere -----------" << std::endl;
+	IntMap<int, int> im;
+
+	for (int i = 0; i < 1000; ++i)
+		im.add(i, i * 2);
+	assert(im.dense());
+	assert(im.size() == 1000);
+	assert(im.value(999) == 1998);
+	assert(im.exists(1000) == false);
+	assert(im.exists(-1) == false);
+
+	// Una chiave lontana rende le chiavi sparse
+	im.add(50000000, 1);
+	assert(im.dense() == false);
+	assert(im.value(500) == 1000);
+	assert(im.value(50000000) == 1);
+
+	// Rimossa la chiave lontana, nuove chiavi vicine riportano all'array
+	im.remove(50000000);
+	im.add(1000, 2000);
+	assert(im.dense());
+	assert(im.value(1000) == 2000);
+
+	try {
+		im.add(5, 0);
+		assert(false);
+	} catch(keyAlreadyDefinedException &e) {
+		assert(im.size() == 1001);
+	}
+
+	// Dopo molte rimozioni l'array diventa sparso; gli estremi sono
+	// quelli delle chiavi rimaste, per cui una chiave vicina basta a
+	// tornare all'array
+	IntMap<int, int> shrink;
+	for (int i = 0; i < 1000; ++i)
+		shrink.add(i, i);
+	for (int i = 0; i < 880; ++i)
+		shrink.remove(i);
+	assert(shrink.dense() == false && shrink.size() == 120);
+	shrink.add(1000, 1000);
+	assert(shrink.dense() && shrink.value(880) == 880 && shrink.value(1000) == 1000);
+
+	// Chiavi negative e ordine delle chiavi
+	IntMap<long long, std::string> neg;
+	neg.add(-5, "meno cinque");
+	neg.add(3, "tre");
+	neg.add(-1000000000000LL, "lontana");
+	std::vector<long long> k = neg.keys();
+	assert(k.size() == 3 && k[0] == -1000000000000LL && k[1] == -5 && k[2] == 3);
+	assert(neg.value(-5) == "meno cinque");
+
+	// Confronto con std::map su operazioni casuali
+	std::mt19937 rng(7);
+	IntMap<int, int> rnd;
+	std::map<int, int> ref;
+	for (int step = 0; step < 20000; ++step) {
+		int range = (step / 5000) % 2 == 0 ? 2000 : 1 << 24;
+		int key = static_cast<int>(rng() % range) - range / 2;
+
+		if (rng() % 3 == 0) {
+			if (ref.erase(key))
+				rnd.remove(key);
+		} else if (ref.find(key) == ref.end()) {
+			ref[key] = step;
+			rnd.add(key, step);
+		}
+	}
+	assert(rnd.size() == ref.size());
+	std::vector<int> rk = rnd.keys();
+	std::size_t i = 0;
+	for (std::map<int, int>::const_iterator b = ref.begin(); b != ref.end(); ++b, ++i) {
+		assert(rk[i] == b->first);
+		assert(rnd.value(b->first) == b->second);
+	}
+
+	IntMap<int, int> copy(rnd);
+	assert(copy.keys() == rk);
+
+	// Chiavi agli estremi dell'intervallo: la finestra dell'array non
+	// deve superare la chiave massima
+	IntMap<int, int> edge;
+	edge.add(2147483593, 1);
+	edge.add(-2147483647, 2);
+	assert(edge.value(2147483593) == 1 && edge.value(-2147483647) == 2);
+	test_int_map_estremi<unsigned char>();
+	test_int_map_estremi<signed char>();
+	test_int_map_estremi<int>();
+	test_int_map_estremi<unsigned int>();
+	test_int_map_estremi<long long>();
+	test_int_map_estremi<unsigned long long>();
+
+	std::cout << "Coppie nella mappa casuale: " << rnd.size()
+		<< (rnd.dense() ? " (densa)" : " (sparsa)") << std::endl;
+	std::cout << "----------- Fine test sulla mappa con chiavi intere -----------" << std::endl;
+}
+
+/**
+  @brief Test della misura della memoria, della preallocazione
+  e della compattazione
+*/
+void test_memoria() {
+	std::cout << "----------- Inizio test sulla memoria occupata dalla mappa -----------" << std::endl;
+	Map<std::string, int, str_equal> mapstr;
+	MemoryUsage empty = mapstr.memory_usage();
+	assert(empty.payload == 0 && empty.reserved == 0);
+
+	mapstr.reserve(100);
+	assert(mapstr.capacity() == 100);
+	assert(mapstr.memory_usage().reserved > 0);
+
+	for (int i = 0; i < 100; ++i)
+		mapstr.add("chiave numero " + std::to_string(i) + " abbastanza lunga da non stare nella SSO", i);
+	assert(mapstr.capacity() == 100);
+	MemoryUsage full = mapstr.memory_usage();
+	assert(full.reserved == 0);
+	assert(full.payload > 100 * sizeof(Pair<std::string, int>));
+	assert(full.total == full.structure + full.payload + full.reserved);
+
+	// Dopo molte rimozioni compact riporta le coppie in un unico blocco
+	for (int i = 0; i < 100; i += 2)
+		mapstr.remove("chiave numero " + std::to_string(i) + " abbastanza lunga da non stare nella SSO");
+	std::vector<std::string> before = mapstr.keys();
+	assert(mapstr.memory_usage().reserved > 0);
+
+	mapstr.shrink_to_fit(); // il blocco è ancora in parte occupato
+	assert(mapstr.capacity() == 100);
+
+	mapstr.compact();
+	assert(mapstr.capacity() == 50);
+	assert(mapstr.memory_usage().reserved == 0);
+	assert(mapstr.keys() == before);
+	assert(mapstr.value("chiave numero 51 abbastanza lunga da non stare nella SSO") == 51);
+
+	// Nodi di blocchi preallocati e nodi allocati singolarmente insieme
+	mapint a, b;
+	a.reserve(10);
+	b.reserve(3);
+	for (int i = 0; i < 20; ++i)
+		a.add(i, i);
+	b.add(100, 1);
+	b.add(5, 2);
+	a.merge(b);
+	assert(a.size() == 21 && b.size() == 1);
+	a.remove(100);
+	mapint c;
+	c = a;
+	assert(c.size() == 20);
+	a.clear();
+	assert(a.capacity() == 0);
+
+	b.remove(5);
+	b.reserve(8);
+	b.shrink_to_fit(); // tutti i blocchi sono liberi
+	assert(b.capacity() == 0);
+
+	std::cout << "Memoria occupata da mapstr: " << mapstr.memory_usage().total << " byte" << std::endl;
+	std::cout << "----------- Fine test sulla memoria occupata dalla mappa -----------" << std::endl;
+}
+
+/**
+  @brief Applica ad una copia locale le modifiche lette dal change feed
+
+  @return false se il consumatore deve ripartire da uno snapshot
+*/
+bool applica_modifiche(const ChangeBatch<int, int> &batch, mapint &replica) {
+	if (batch.snapshot_required)
+		return false;
+
+	for (const Change<int, int> &c : batch.changes) {
+		if (c.type == Change<int, int>::added)
+			replica.add(c.key, c.value);
+		else if (c.type == Change<int, int>::removed)
+			replica.remove(c.key);
+		else
+			replica.find(c.key)->value = c.value;
+	}
+	return true;
+}
+
+/**
+  @brief Test del change feed e della replica incrementale
+*/
+void test_change_feed() {
+	std::cout << "----------- Inizio test sul change feed -----------" << std::endl;
+	FeedMap<int, int, int_equal> fm(8);
+	mapint replica;
+	std::uint64_t seq = fm.snapshot(replica);
+	assert(seq == 0 && replica.size() == 0);
+
+	fm.add(1, 10);
+	fm.add(2, 20);
+	fm.update(1, 11);
+	fm.remove(2);
+	fm.add(3, 30);
+
+	// Lettura a blocchi di due modifiche
+	ChangeBatch<int, int> batch = fm.changes_since(seq, 2);
+	assert(batch.changes.size() == 2 && batch.last_seq == 2);
+	assert(applica_modifiche(batch, replica));
+	batch = fm.changes_since(batch.last_seq);
+	assert(batch.changes.size() == 3 && batch.last_seq == 5);
+	assert((batch.changes[0].type == Change<int, int>::updated));
+	assert(applica_modifiche(batch, replica));
+	seq = batch.last_seq;
+
+	assert(replica.size() == 2);
+	assert(replica.value(1) == 11 && replica.value(3) == 30);
+	assert(fm.changes_since(seq).changes.empty());
+
+	try {
+		fm.update(42, 0);
+		assert(false);
+	} catch(keyNotFoundException &e) {
+		assert(fm.last_seq() == 5);
+	}
+
+	// Un consumatore troppo lento deve ripartire da uno snapshot
+	for (int i = 100; i < 120; ++i)
+		fm.add(i, i);
+	batch = fm.changes_since(seq);
+	assert(applica_modifiche(batch, replica) == false);
+	seq = fm.snapshot(replica);
+	assert(seq == 25 && replica.size() == fm.size());
+	assert(fm.changes_since(seq).changes.empty());
+
+	std::cout << "Coppie replicate: " << replica.size() << std::endl;
+	std::cout << "----------- Fine test sul change feed -----------" << std::endl;
+}
+
+/**
+  @brief Test della mappa con valori compressi e del codec LZ
+*/
+void test_valori_compressi() {
+	std::cout << "----------- Inizio test sui valori compressi -----------" << std::endl;
+	LzCodec plain;
+	std::string out;
+
+	// Casi limite del codec: valore vuoto, ripetizioni sovrapposte, dati casuali
+	std::mt19937 rng(7);
+	std::string random_bytes;
+	for (int i = 0; i < 5000; ++i)
+		random_bytes.push_back(static_cast<char>(rng()));
+	std::string inputs[] = {"", "abc", std::string(10000, 'x'), random_bytes};
+	for (const std::string &in : inputs) {
+		std::string packed;
+		plain.compress(in.data(), in.size(), packed);
+		plain.decompress(packed.data(), packed.size(), out);
+		assert(out == in);
+		assert(LzCodec::raw_size(packed.data(), packed.size()) == in.size());
+	}
+
+	std::string packed;
+	plain.compress(inputs[2].data(), inputs[2].size(), packed);
+	assert(packed.size() < 100);
+	try {
+		plain.decompress(packed.data(), packed.size() - 3, out);
+		assert(false);
+	} catch(std::runtime_error &e) {}
+
+	// Intestazione corrotta: una lunghezza enorme non deve essere
+	// allocata, un varint oltre i 64 bit non deve essere letto
+	std::string huge("\xff\xff\xff\xff\x7f\x00", 6);
+	try {
+		plain.decompress(huge.data(), huge.size(), out);
+		assert(false);
+	} catch(std::runtime_error &e) {}
+	std::string endless(12, '\x80');
+	endless.push_back('\x01');
+	try {
+		LzCodec::raw_size(endless.data(), endless.size());
+		assert(false);
+	} catch(std::runtime_error &e) {}
+
+	// Record brevi con la stessa struttura: il dizionario addestrato
+	// permette di comprimerli anche singolarmente
+	std::vector<std::string> records;
+	for (int i = 0; i < 1000; ++i)
+		records.push_back("{\"id\":" + std::to_string(i) + ",\"status\":\"active\",\"region\":\"europe-west\","
+			"\"tags\":[\"customer\",\"premium\",\"newsletter\"],\"score\":" + std::to_string(i % 7) + "}");
+	std::vector<std::string> samples(records.begin(), records.begin() + 100);
+	LzCodec trained(LzCodec::train(samples, 4096));
+	assert(!trained.dictionary().empty() && trained.dictionary().size() <= 4096);
+
+	// La tabella di lavoro è condivisa dai codec dello stesso thread:
+	// l'alternanza tra codec diversi non deve cambiare il risultato
+	std::string first, again, other;
+	plain.compress(records[1].data(), records[1].size(), first);
+	trained.compress(records[1].data(), records[1].size(), other);
+	plain.compress(records[1].data(), records[1].size(), again);
+	assert(first == again && other.size() < first.size());
+	trained.decompress(other.data(), other.size(), out);
+	assert(out == records[1]);
+
+	CompressedMap<int, int_equal> cm(trained, 4);
+	for (int i = 0; i < 1000; ++i)
+		cm.add(i, records[i]);
+	assert(cm.size() == 1000);
+	assert(cm.compressed_bytes() * 3 < cm.raw_bytes());
+
+	for (int i = 0; i < 1000; i += 37) {
+		cm.value(i, out);
+		assert(out == records[i]);
+		assert(cm.value(i) == records[i]);
+	}
+
+	// La rimozione invalida la voce in cache
+	assert(cm.value(5) == records[5]);
+	std::size_t raw = cm.raw_bytes();
+	cm.remove(5);
+	assert(!cm.exists(5) && cm.raw_bytes() == raw - records[5].size());
+	try {
+		cm.value(5);
+		assert(false);
+	} catch(keyNotFoundException &e) {}
+
+	std::cout << "Byte originali: " << cm.raw_bytes() << ", compressi: " << cm.compressed_bytes() << std::endl;
+	std::cout << "----------- Fine test sui valori compressi -----------" << std::endl;
+}
+
+/**
+  @brief Test del conteggio delle chiavi frequenti
+
+  Verifica le chiavi più lette con conteggio esatto e con
+  campionamento, e l'azzeramento delle statistiche.
+*/
+void test_chiavi_frequenti() {
+	std::cout << "----------- Inizio test sulle chiavi frequenti -----------" << std::endl;
+	HotKeyMap<int, int, int_equal, pod_hash<int>> hm(16);
+	for (int i = 0; i < 1000; ++i)
+		hm.add(i, i);
+
+	// Due chiavi dominano il traffico, le altre sono lette una volta
+	for (int i = 0; i < 1000; ++i) {
+		assert(hm.value(i) == i);
+		for (int j = 0; j < 5; ++j)
+			assert(hm.exists(7));
+		for (int j = 0; j < 3; ++j)
+			assert(hm.value(3) == 3);
+	}
+	assert(hm.sampled() == 10000);
+
+	std::vector<HotKey<int>> top = hm.top_keys(2);
+	assert(top.size() == 2);
+	assert(top[0].key == 7 && top[1].key == 3);
+	assert(top[0].guaranteed <= 5002 && top[0].count >= 5002);
+	assert(top[1].guaranteed <= 3002 && top[1].count >= 3002);
+
+	hm.reset_stats();
+	assert(hm.top_keys(10).empty());
+
+	// Con il campionamento i conteggi sono stimati
+	HotKeyMap<int, int, int_equal, pod_hash<int>> sampled(16, 8);
+	for (int i = 0; i < 100; ++i)
+		sampled.add(i, i);
+	for (int i = 0; i < 20000; ++i) {
+		sampled.exists(i % 100);
+		sampled.exists(42);
+	}
+	top = sampled.top_keys(1);
+	assert(top.size() == 1 && top[0].key == 42);
+	assert(top[0].count > 15000 && top[0].count < 30000);
+
+	std::cout << "Chiave piu' frequente: " << top[0].key << " (circa " << top[0].count << " accessi)" << std::endl;
+	std::cout << "----------- Fine test sulle chiavi frequenti -----------" << std::endl;
+}
+
+/**
+  @brief Test delle scritture raggruppate in blocchi
+*/
+void test_scritture_a_blocchi() {
+	std::cout << "----------- Inizio test sulle scritture a blocchi -----------" << std::endl;
+	mapint m;
+	for (int i = 0; i < 10; ++i)
+		m.add(i, i);
+
+	typedef BatchOp<int, int> op;
+	std::vector<op> ops = {
+		{op::put, 1, 100}, // aggiornamento
+		{op::erase, 2, 0}, // rimozione
+		{op::put, 20, 20}, // inserimento
+		{op::put, 21, 1}, {op::put, 21, 2}, // vale solo l'ultima
+		{op::put, 22, 0}, {op::erase, 22, 0}, // inserita e rimossa: nessun effetto
+		{op::erase, 3, 0}, {op::put, 3, 33}, // rimossa e reinserita: aggiornamento
+		{op::erase, 99, 0} // chiave assente
+	};
+	BatchResult r = m.apply_batch(ops);
+	assert(r.inserted == 2 && r.updated == 2 && r.removed == 1 && r.discarded == 3);
+	assert(m.size() == 11);
+	assert(m.value(1) == 100 && !m.exists(2) && m.value(3) == 33);
+	assert(m.value(20) == 20 && m.value(21) == 2 && !m.exists(22));
+
+	// Un batch piccolo su una mappa grande non riserva nodi in
+	// proporzione alla mappa
+	mapint big;
+	big.reserve(5000);
+	for (int i = 0; i < 5000; ++i)
+		big.add(i, i);
+	big.apply_batch(std::vector<op>{{op::put, -1, -1}});
+	assert(big.size() == 5001 && big.capacity() - big.size() < 16);
+	mapint plain;
+	for (int i = 0; i < 5000; ++i)
+		plain.add(i, i);
+	plain.apply_batch(std::vector<op>{{op::put, -1, -1}});
+	assert(plain.capacity() == plain.size());
+
+	// Più thread scrivono sulla stessa mappa con il proprio writer
+	Map<int, int, int_equal, pod_hash<int>> shared;
+	std::mutex mutex;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t) {
+		threads.emplace_back([&shared, &mutex, t]() {
+			BatchWriter<int, int, int_equal, pod_hash<int>> writer(shared, mutex, 64);
+			for (int i = 0; i < 2000; ++i)
+				writer.put(t * 10000 + i, i);
+			for (int i = 0; i < 2000; i += 2)
+				writer.erase(t * 10000 + i);
+			writer.flush();
+			assert(writer.pending() == 0);
+			assert(writer.totals().inserted + writer.totals().discarded >= 2000);
+		});
+	}
+	for (std::thread &th : threads)
+		th.join();
+
+	assert(shared.size() == 4000);
+	assert(shared.value(10001) == 1 && !shared.exists(10000));
+
+	// Il distruttore applica le operazioni in attesa
+	{
+		BatchWriter<int, int, int_equal, pod_hash<int>> writer(shared, mutex, 1000, std::chrono::hours(1));
+		writer.put(-1, -1);
+		assert(writer.pending() == 1 && !shared.exists(-1));
+	}
+	assert(shared.value(-1) == -1);
+
+	std::cout << "Coppie scritte: " << shared.size() << std::endl;
+	std::cout << "----------- Fine test sulle scritture a blocchi -----------" << std::endl;
+}
+
+/**
+  @brief Test della mappa con più valori per chiave
+*/
+void test_multi_map() {
+	std::cout << "----------- Inizio test su MultiMap -----------" << std::endl;
+	MultiMap<std::string, int, str_equal> mm;
+	assert(mm.count("a") == 0 && mm.values("a").empty());
+
+	mm.append("a", 1);
+	mm.append("b", 10);
+	mm.append("a", 2);
+	mm.append("a", 3); // segmento di "a" spostato in fondo
+	assert(mm.size() == 2 && mm.total_values() == 4);
+	assert(mm.count("a") == 3 && mm.count("b") == 1);
+
+	std::span<const int> a = mm.values("a");
+	assert(a.size() == 3 && a[0] == 1 && a[1] == 2 && a[2] == 3);
+
+	// Confronto con una std::map di vettori su inserimenti e rimozioni casuali
+	MultiMap<int, int, int_equal> index;
+	std::map<int, std::vector<int>> expected;
+	std::mt19937 rng(11);
+	for (int i = 0; i < 20000; ++i) {
+		int k = static_cast<int>(rng() % 200);
+		if (rng() % 50 == 0 && index.exists(k)) {
+			index.remove(k);
+			expected.erase(k);
+		} else {
+			index.append(k, i);
+			expected[k].push_back(i);
+		}
+	}
+
+	assert(index.size() == expected.size());
+	for (const std::pair<const int, std::vector<int>> &e : expected) {
+		std::span<const int> v = index.values(e.first);
+		assert(index.count(e.first) == e.second.size());
+		assert(std::equal(v.begin(), v.end(), e.second.begin(), e.second.end()));
+	}
+
+	index.compact();
+	MemoryUsage m = index.memory_usage();
+	assert(m.reserved == 0 && m.payload == index.total_values() * sizeof(int));
+	for (const std::pair<const int, std::vector<int>> &e : expected) {
+		std::span<const int> v = index.values(e.first);
+		assert(std::equal(v.begin(), v.end(), e.second.begin(), e.second.end()));
+	}
+
+	try {
+		index.remove(-1);
+		assert(false);
+	} catch(keyNotFoundException &e) {}
+
+	std::cout << "Chiavi: " << index.size() << ", valori: " << index.total_values() << std::endl;
+	std::cout << "----------- Fine test su MultiMap -----------" << std::endl;
+}
+
 int main() {
 
 	test_metodi_fondamentali_primitivi();
@@ -424,6 +1532,34 @@ int main() {
 
 	test_mapint_parameter_const(maptest);
 
+	test_operazioni_parallele();
+
+	test_viste();
+
+	test_operazioni_insiemistiche();
+
+	test_hash_e_confronti();
+
+	test_esportazione();
+
+	test_durable_map();
+
+	test_ricerca_asincrona();
+
+	test_int_map();
+
+	test_memoria();
+
+	test_change_feed();
+
+	test_valori_compressi();
+
+	test_chiavi_frequenti();
+
+	test_scritture_a_blocchi();
+
+	test_multi_map();
+
 	//test_eccezione_chiave_presente();
 
 	//test_eccezione_rimozione_chiave_non_presente();
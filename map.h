@@ -12,6 +12,17 @@
 #include <iterator> // std::forward_iterator_tag
 #include <cstddef>  // std::ptrdiff_t
 #include <cassert> // assert
+#include <atomic> // std::atomic
+#include <type_traits> // std::remove_const, std::basic_common_reference
+#include <new> // placement new, std::align_val_t
+#include <functional> // std::less
+#include <string> // std::string
+#include <cstdint> // std::uint64_t
+#include <utility> // std::pair, std::move
+#include "thread_pool.h" // pool di thread per le operazioni parallele
+#ifdef __cpp_impl_coroutine
+#include "async_lookup.h" // ricerche asincrone con coroutine (C++20)
+#endif
 #include "key_not_found_exception.h" // eccezione custom per remove e value
 #include "key_already_defined_exception.h" // eccezione custom per add
 
@@ -70,6 +81,168 @@ struct Pair {
 
 }; // struct pair
 
+/**
+	@brief Struct PairRef
+
+	Riferimento ad una coppia della mappa restituito dagli iteratori non
+	costanti: il valore è modificabile, la chiave è esposta in sola
+	lettura perché determina la posizione della coppia (unicità e hash
+	memorizzato nel nodo).
+*/
+template <typename C, typename V>
+struct PairRef {
+	const C &key; // chiave, in sola lettura
+	V &value; // valore
+
+	/**
+		Costruttore
+
+		@param k chiave della coppia
+		@param v valore della coppia
+	*/
+	PairRef(const C &k, V &v) : key(k), value(v) {}
+
+	/**
+		Costruttore da una coppia non costante
+
+		@param p coppia riferita
+	*/
+	PairRef(Pair<C, V> &p) : key(p.key), value(p.value) {}
+
+	/**
+		Accesso ai campi tramite l'operatore freccia dell'iteratore
+	*/
+	const PairRef *operator->() const {
+		return this;
+	}
+
+	/**
+		Copia della coppia riferita
+	*/
+	operator Pair<C, V>() const {
+		return Pair<C, V>(key, value);
+	}
+
+}; // struct PairRef
+
+/*
+	Tipo comune tra PairRef e Pair, richiesto dai concept degli
+	iteratori di C++20 (std::indirectly_readable) per Map::iterator,
+	il cui reference è PairRef e il cui value_type è Pair: il tipo
+	comune è la coppia per valore, in cui entrambi sono convertibili.
+*/
+template <typename C, typename V, template <typename> class TQual, template <typename> class UQual>
+struct std::basic_common_reference<PairRef<C, V>, Pair<C, V>, TQual, UQual> {
+	typedef Pair<C, V> type;
+};
+
+template <typename C, typename V, template <typename> class TQual, template <typename> class UQual>
+struct std::basic_common_reference<Pair<C, V>, PairRef<C, V>, TQual, UQual> {
+	typedef Pair<C, V> type;
+};
+
+template <typename C, typename V>
+struct std::common_type<PairRef<C, V>, Pair<C, V>> {
+	typedef Pair<C, V> type;
+};
+
+template <typename C, typename V>
+struct std::common_type<Pair<C, V>, PairRef<C, V>> {
+	typedef Pair<C, V> type;
+};
+
+/**
+	@brief Struct MemoryUsage
+
+	Occupazione di memoria di una Map, in byte, restituita da
+	Map::memory_usage().
+*/
+struct MemoryUsage {
+	std::size_t structure; // oggetto Map, puntatori e hash dei nodi, overhead dell'allocatore
+	std::size_t payload; // coppie <chiave, valore> e memoria dinamica da esse posseduta
+	std::size_t reserved; // nodi preallocati non utilizzati
+	std::size_t total; // somma delle tre voci precedenti
+
+	MemoryUsage() : structure(0), payload(0), reserved(0), total(0) {}
+};
+
+/**
+	@brief Memoria dinamica posseduta da un dato.
+
+	Usata da Map::memory_usage() per le chiavi e i valori. Di default
+	un dato non possiede memoria dinamica; per i propri tipi è possibile
+	definire un overload di map_heap_bytes nello stesso namespace del tipo.
+
+	@return numero di byte allocati dinamicamente dal dato
+*/
+template <typename T>
+std::size_t map_heap_bytes(const T &) {
+	return 0;
+}
+
+// Le stringhe corte sono memorizzate nell'oggetto stesso (SSO)
+inline std::size_t map_heap_bytes(const std::string &s) {
+	const char *obj = reinterpret_cast<const char *>(&s);
+	if (!std::less<const char *>()(s.data(), obj) && std::less<const char *>()(s.data(), obj + sizeof(s)))
+		return 0;
+	return s.capacity() + 1;
+}
+
+template <typename T>
+std::size_t map_heap_bytes(const std::vector<T> &v) {
+	std::size_t n = v.capacity() * sizeof(T);
+	for (const T &x : v)
+		n += map_heap_bytes(x);
+	return n;
+}
+
+/**
+	@brief Funtore di hash nullo
+
+	Funtore di default per il parametro H della classe Map: indica che
+	non è disponibile una funzione di hash per le chiavi, per cui i nodi
+	non memorizzano alcun hash e le ricerche usano solo il funtore di
+	uguaglianza.
+*/
+template <typename C>
+struct no_hash {
+	std::size_t operator()(const C &) const {
+		return 0;
+	}
+};
+
+/**
+	@brief Struct BatchOp
+
+	Operazione di scrittura raccolta in un blocco e applicata con
+	Map::apply_batch.
+*/
+template <typename C, typename V>
+struct BatchOp {
+	enum kind {
+		put,  // inserisce la coppia o ne sostituisce il valore
+		erase // rimuove la coppia se presente (value non significativo)
+	};
+
+	kind type; // tipo di operazione
+	C key; // chiave della coppia
+	V value; // valore (per put)
+};
+
+/**
+	@brief Struct BatchResult
+
+	Esito di Map::apply_batch.
+*/
+struct BatchResult {
+	unsigned int inserted; // coppie aggiunte
+	unsigned int updated; // coppie esistenti con valore sostituito
+	unsigned int removed; // coppie rimosse
+	unsigned int discarded; // operazioni superate da una successiva sulla stessa chiave
+
+	BatchResult() : inserted(0), updated(0), removed(0), discarded(0) {}
+};
+
 /**
   @brief Classe Map
 
@@ -79,11 +252,46 @@ struct Pair {
   La classe si aspetta di ricevere dall'utente anche un funtore
   per poter definire come viene controllata l'uguaglianza di due chiavi,
   non essendo noto a priori come è fatto un dato di tipo C.
+  Opzionalmente è possibile fornire anche un funtore di hash H
+  coerente con Eq (chiavi uguali devono avere lo stesso hash): in tal
+  caso ogni nodo memorizza l'hash della propria chiave, che viene
+  confrontato prima di invocare Eq, per cui la maggior parte dei
+  confronti con chiavi diverse si riduce al confronto di due interi.
 
 */
-template <typename C, typename V, typename Eq>
+template <typename C, typename V, typename Eq, typename H = no_hash<C>>
 class Map {
 
+	// true se è stato fornito un funtore di hash
+	static const bool hashed = !std::is_same<H, no_hash<C>>::value;
+
+	// Dimensione massima di un blocco di nodi creato da apply_batch
+	static const unsigned int max_batch_slab = 1 << 16;
+
+	/**
+		@brief Struct HashSlot
+
+		Hash della chiave memorizzato nel nodo. La specializzazione per
+		le mappe senza funtore di hash è vuota e non occupa memoria.
+	*/
+	template <bool Hashed, typename Dummy = void>
+	struct HashSlot {
+		std::size_t hash; // hash della chiave
+
+		HashSlot() : hash(0) {}
+
+		std::size_t get_hash() const { return hash; }
+
+		void set_hash(std::size_t h) { hash = h; }
+	};
+
+	template <typename Dummy>
+	struct HashSlot<false, Dummy> {
+		std::size_t get_hash() const { return 0; }
+
+		void set_hash(std::size_t) {}
+	};
+
 	/**
 		@brief Struct Node
 
@@ -91,7 +299,7 @@ class Map {
 		nodo, utile per la creazione di una lista da utilizzare per 
 		salvare le coppie.
   	*/
-	struct Node {
+	struct Node : HashSlot<hashed> {
 		Pair<C, V> item; // Coppia <chiave, valore> da memorizzare
 		Node *next; // Puntatore al nodo successivo della lista
 
@@ -129,7 +337,7 @@ class Map {
 
       		@param other nodo da copiare
     	*/
-    	Node(const Node &other) : item(other.item), next(other.next) {}
+    	Node(const Node &other) : HashSlot<hashed>(other), item(other.item), next(other.next) {}
 
 		/**
 			Operatore di assegnamento 
@@ -138,6 +346,7 @@ class Map {
 			@return reference al nodo this
     	*/
 		Node& operator=(const Node &other) {
+			this->set_hash(other.get_hash());
 			item = other.item;
 			next = other.next;
 			return *this;
@@ -153,6 +362,414 @@ class Map {
 	Node *_head; // Puntatore al primo nodo della lista interna
 	unsigned int _size; // Numero di nodi della lista e, quindi, di coppie
 	Eq _fequal; // Funtore per l'uguaglianza tra chiavi di tipo generico C
+	H _fhash; // Funtore di hash per le chiavi (no_hash se non fornito)
+
+	/**
+		@brief Struct Slab
+
+		Blocco contiguo di nodi preallocati da reserve o compact.
+	*/
+	struct Slab {
+		Node *mem; // primo nodo del blocco
+		unsigned int capacity; // numero di nodi del blocco
+	};
+
+	std::vector<Slab> _slabs; // blocchi di nodi preallocati
+	void *_free; // lista dei nodi liberi dei blocchi (collegati tramite il primo puntatore)
+	unsigned int _free_count; // numero di nodi liberi
+
+	/**
+		@brief Alloca la memoria (non inizializzata) per n nodi contigui.
+	*/
+	static Node *allocate_nodes(unsigned int n) {
+		return static_cast<Node *>(::operator new(n * sizeof(Node), std::align_val_t(alignof(Node))));
+	}
+
+	static void deallocate_nodes(Node *mem) {
+		::operator delete(mem, std::align_val_t(alignof(Node)));
+	}
+
+	/**
+		@brief Indice del blocco che contiene un nodo.
+
+		@return indice in _slabs, -1 se il nodo è stato allocato singolarmente
+	*/
+	int slab_of(const void *n) const {
+		std::less<const void *> lt;
+		for (std::size_t i = 0; i < _slabs.size(); ++i) {
+			if (!lt(n, _slabs[i].mem) && lt(n, _slabs[i].mem + _slabs[i].capacity))
+				return static_cast<int>(i);
+		}
+		return -1;
+	}
+
+	/**
+		@brief Crea un nodo, usando se possibile un nodo libero dei
+		blocchi preallocati.
+
+		@param p coppia da memorizzare
+		@param next nodo successivo
+		@param h hash della chiave
+		@return il nodo creato
+		@throw se l'allocazione o la copia della coppia falliscono
+		lancia un'eccezione
+	*/
+	Node *new_node(const Pair<C, V> &p, Node *next, std::size_t h) {
+		Node *n;
+
+		if (_free != nullptr) {
+			void *slot = _free;
+			void *next_free = *static_cast<void **>(slot);
+			try {
+				n = new (slot) Node(p, next);
+			} catch(...) {
+				*static_cast<void **>(slot) = next_free; // ripristino la lista dei liberi
+				throw;
+			}
+			_free = next_free;
+			_free_count--;
+		} else {
+			n = new Node(p, next);
+		}
+
+		n->set_hash(h);
+		return n;
+	}
+
+	/**
+		@brief Distrugge un nodo; se appartiene ad un blocco il nodo
+		torna nella lista dei liberi, altrimenti viene deallocato.
+	*/
+	void delete_node(Node *n) {
+		if (slab_of(n) < 0) {
+			delete n;
+			return;
+		}
+
+		n->~Node();
+		*static_cast<void **>(static_cast<void *>(n)) = _free;
+		_free = n;
+		_free_count++;
+	}
+
+	/**
+		@brief Aggiunge un blocco di n nodi liberi.
+	*/
+	void add_slab(unsigned int n) {
+		Node *mem = allocate_nodes(n);
+		try {
+			_slabs.push_back(Slab{mem, n});
+		} catch(...) {
+			deallocate_nodes(mem);
+			throw;
+		}
+
+		// Inserimento in ordine inverso, così i nodi vengono
+		// usati in ordine di indirizzo
+		for (unsigned int i = n; i > 0; --i) {
+			*static_cast<void **>(static_cast<void *>(mem + i - 1)) = _free;
+			_free = mem + i - 1;
+		}
+		_free_count += n;
+	}
+
+	/**
+		@brief Dealloca tutti i blocchi.
+
+		@pre nessun nodo della lista si trova in un blocco
+	*/
+	void release_slabs() {
+		for (const Slab &slab : _slabs)
+			deallocate_nodes(slab.mem);
+		_slabs.clear();
+		_free = nullptr;
+		_free_count = 0;
+	}
+
+	/**
+		@brief Scambia il contenuto di due mappe.
+	*/
+	void swap(Map &other) {
+		std::swap(_head, other._head);
+		std::swap(_size, other._size);
+		std::swap(_fequal, other._fequal);
+		std::swap(_fhash, other._fhash);
+		_slabs.swap(other._slabs);
+		std::swap(_free, other._free);
+		std::swap(_free_count, other._free_count);
+	}
+
+	/**
+		@brief Verifica se un nodo contiene una certa chiave.
+
+		Se la mappa ha un funtore di hash confronta prima l'hash
+		memorizzato nel nodo e invoca il funtore di uguaglianza solo
+		se gli hash coincidono.
+
+		@param n nodo da verificare
+		@param key chiave cercata
+		@param h hash della chiave cercata
+		@return true se il nodo contiene la chiave
+	*/
+	bool matches(const Node *n, const C &key, std::size_t h) const {
+		if (hashed && n->get_hash() != h)
+			return false;
+		return _fequal(key, n->item.key);
+	}
+
+	/**
+		@brief Cerca un nodo per chiave a partire da un nodo dato.
+
+		@param key chiave da cercare
+		@param h hash della chiave (calcolato con _fhash)
+		@param from nodo da cui iniziare la ricerca
+		@return il nodo con chiave key, nullptr se non presente
+	*/
+	Node *find_node(const C &key, std::size_t h, Node *from) const {
+		for (Node *current = from; current != nullptr; current = current->next) {
+			if (matches(current, key, h))
+				return current;
+		}
+		return nullptr;
+	}
+
+	/**
+		@brief Rimuove e dealloca un nodo della lista.
+
+		@param previous nodo che precede current (nullptr se in testa)
+		@param current nodo da rimuovere
+
+		@post _size = _size - 1
+	*/
+	void unlink(Node *previous, Node *current) {
+		if (previous == nullptr)
+			_head = current->next;
+		else
+			previous->next = current->next;
+
+		delete_node(current);
+		_size--;
+	}
+
+	/**
+		@brief Raccoglie i puntatori ai nodi nell'ordine della lista.
+
+		Usata dalle operazioni parallele per poter suddividere il
+		lavoro tra i thread, dato che la lista non è ad accesso casuale.
+
+		@return vettore dei nodi della lista
+	*/
+	std::vector<const Node *> nodes() const {
+		std::vector<const Node *> n;
+		n.reserve(_size);
+
+		for (const Node *current = _head; current != nullptr; current = current->next)
+			n.push_back(current);
+
+		return n;
+	}
+
+	/**
+		@brief Indice hash temporaneo su un insieme di chiavi.
+
+		Tabella ad indirizzamento aperto di puntatori alle chiavi, usata
+		dalle operazioni su molte chiavi quando è disponibile un funtore
+		di hash. Le chiavi non vengono copiate e devono restare valide
+		finché l'indice è in uso.
+
+		@tparam T dato associato ad ogni chiave
+	*/
+	template <typename T>
+	class KeyIndex {
+	public:
+		/**
+			@param n numero massimo di chiavi da inserire
+			@param eq funtore di uguaglianza tra chiavi
+		*/
+		KeyIndex(std::size_t n, const Eq &eq) : _mask(1), _eq(eq) {
+			while (_mask < n * 2)
+				_mask <<= 1;
+			_slots.resize(_mask);
+			_mask--;
+		}
+
+		/**
+			@return il dato associato alla chiave, nullptr se non presente
+		*/
+		const T *find(const C &key, std::size_t h) const {
+			for (std::size_t p = start(h); _slots[p].key != nullptr; p = (p + 1) & _mask) {
+				if (_slots[p].hash == h && _eq(*_slots[p].key, key))
+					return &_slots[p].data;
+			}
+			return nullptr;
+		}
+
+		/**
+			@brief Inserisce una chiave se non è già presente.
+
+			@return false se la chiave era già presente
+		*/
+		bool insert(const C &key, std::size_t h, const T &data) {
+			std::size_t p = start(h);
+			for (; _slots[p].key != nullptr; p = (p + 1) & _mask) {
+				if (_slots[p].hash == h && _eq(*_slots[p].key, key))
+					return false;
+			}
+			_slots[p] = Slot{h, &key, data};
+			return true;
+		}
+
+	private:
+		struct Slot {
+			std::size_t hash;
+			const C *key; // nullptr se la posizione è libera
+			T data;
+		};
+
+		// Posizione iniziale: hash rimescolato, per tollerare hash poco uniformi
+		std::size_t start(std::size_t h) const {
+			std::uint64_t x = static_cast<std::uint64_t>(h) * 0x9e3779b97f4a7c15ULL;
+			return static_cast<std::size_t>(x ^ (x >> 32)) & _mask;
+		}
+
+		std::vector<Slot> _slots;
+		std::size_t _mask;
+		const Eq &_eq;
+	};
+
+	/**
+		@brief Indice hash dei nodi della mappa.
+
+		Costruito solo se è disponibile un funtore di hash; altrimenti
+		l'indice è vuoto e lookup scorre la lista.
+	*/
+	KeyIndex<Node *> node_index() const {
+		KeyIndex<Node *> index(hashed ? _size : 0, _fequal);
+		if (hashed) {
+			for (Node *current = _head; current != nullptr; current = current->next)
+				index.insert(current->item.key, current->get_hash(), current);
+		}
+		return index;
+	}
+
+	/**
+		@brief Cerca un nodo tramite l'indice costruito da node_index, o
+		scorrendo la lista a partire da from se la mappa non ha funtore
+		di hash.
+
+		@return il nodo con chiave key, nullptr se non presente
+	*/
+	Node *lookup(const KeyIndex<Node *> &index, const C &key, std::size_t h, Node *from) const {
+		if (hashed) {
+			Node *const *n = index.find(key, h);
+			return n != nullptr ? *n : nullptr;
+		}
+		return find_node(key, h, from);
+	}
+
+	/**
+		@brief Suddivide l'intervallo [0, count) in blocchi tra i thread
+		del pool e attende il loro completamento.
+
+		I blocchi sono più numerosi dei thread in modo che il
+		work-stealing possa bilanciare il carico.
+
+		@param pool pool di thread da utilizzare
+		@param count numero di elementi da elaborare
+		@param fn funzione invocata come fn(inizio, fine) su ogni blocco
+		@throw rilancia la prima eccezione sollevata da fn
+	*/
+	template <typename F>
+	static void for_chunks(ThreadPool &pool, std::size_t count, F fn) {
+		if (count == 0)
+			return;
+
+		std::size_t chunks = static_cast<std::size_t>(pool.size()) * 4;
+		std::size_t step = (count + chunks - 1) / chunks;
+
+		// Un gruppo per chiamata: il pool può essere condiviso con altri
+		// thread senza attenderne i task né riceverne le eccezioni
+		TaskGroup group(pool);
+		for (std::size_t b = 0; b < count; b += step) {
+			std::size_t e = std::min(count, b + step);
+			group.run([&fn, b, e] { fn(b, e); });
+		}
+
+		group.wait();
+	}
+
+	/**
+		@brief Verifica dei duplicati e allocazione dei nodi di
+		parallel_build, per le mappe con funtore di hash.
+
+		Le chiavi della sequenza e quelle già presenti nella mappa
+		vengono suddivise in partizioni secondo i bit alti del loro hash
+		(chiavi uguali finiscono nella stessa partizione); ogni partizione
+		viene poi verificata da un thread con il proprio KeyIndex.
+
+		@param first inizio della sequenza
+		@param hs hash delle chiavi della sequenza
+		@param n nodi allocati (uno per elemento della sequenza)
+		@param duplicate impostato a true se viene trovato un duplicato
+		@param pool pool di thread da utilizzare
+	*/
+	template <typename RandomIt>
+	void build_partitioned(RandomIt first, const std::vector<std::size_t> &hs,
+		std::vector<Node *> &n, std::atomic<bool> &duplicate, ThreadPool &pool) const {
+		const std::size_t count = hs.size();
+		unsigned int bits = 2;
+		while ((std::size_t(1) << bits) < static_cast<std::size_t>(pool.size()) * 4)
+			bits++;
+		const std::size_t parts = std::size_t(1) << bits;
+
+		auto part_of = [bits](std::size_t h) {
+			return static_cast<std::size_t>((static_cast<std::uint64_t>(h) * 0x9e3779b97f4a7c15ULL) >> (64 - bits));
+		};
+
+		// Suddivisione stabile (counting sort) degli indici della sequenza
+		// e dei nodi della mappa per partizione
+		std::vector<const Node *> existing = nodes();
+		std::vector<std::size_t> in_start(parts + 1, 0), ex_start(parts + 1, 0);
+		for (std::size_t i = 0; i < count; ++i)
+			in_start[part_of(hs[i]) + 1]++;
+		for (const Node *node : existing)
+			ex_start[part_of(node->get_hash()) + 1]++;
+		for (std::size_t p = 0; p < parts; ++p) {
+			in_start[p + 1] += in_start[p];
+			ex_start[p + 1] += ex_start[p];
+		}
+
+		std::vector<std::size_t> in_idx(count);
+		std::vector<const Node *> ex(existing.size());
+		{
+			std::vector<std::size_t> in_pos(in_start.begin(), in_start.end() - 1);
+			std::vector<std::size_t> ex_pos(ex_start.begin(), ex_start.end() - 1);
+			for (std::size_t i = 0; i < count; ++i)
+				in_idx[in_pos[part_of(hs[i])]++] = i;
+			for (const Node *node : existing)
+				ex[ex_pos[part_of(node->get_hash())]++] = node;
+		}
+
+		for_chunks(pool, parts, [&](std::size_t b, std::size_t e) {
+			for (std::size_t p = b; p < e && !duplicate; ++p) {
+				KeyIndex<bool> index((in_start[p + 1] - in_start[p]) + (ex_start[p + 1] - ex_start[p]), _fequal);
+
+				for (std::size_t k = ex_start[p]; k < ex_start[p + 1]; ++k)
+					index.insert(ex[k]->item.key, ex[k]->get_hash(), true);
+
+				for (std::size_t k = in_start[p]; k < in_start[p + 1]; ++k) {
+					std::size_t i = in_idx[k];
+					if (!index.insert(first[i].key, hs[i], true)) {
+						duplicate = true;
+						return;
+					}
+
+					n[i] = new Node(Pair<C, V>(first[i].key, first[i].value));
+					n[i]->set_hash(hs[i]);
+				}
+			}
+		});
+	}
 
 public:
 
@@ -162,7 +779,7 @@ public:
 		@post _head == nullptr
 		@post _size == 0
   	*/
-	Map() : _head(nullptr), _size(0) {}
+	Map() : _head(nullptr), _size(0), _free(nullptr), _free_count(0) {}
 
 	/**
 		Copy constructor
@@ -171,7 +788,7 @@ public:
 		@throw se l'allocazione delle risorse fallisce lancia un'eccezione
 		@post _size = other._size
   	*/
-	Map(const Map &other) : _head(nullptr), _size(0) {
+	Map(const Map &other) : _head(nullptr), _size(0), _free(nullptr), _free_count(0) {
 		Node *current = other._head;
 
 		// La mappa viene riempita ciclando sui nodi di other,
@@ -202,8 +819,7 @@ public:
 	Map& operator=(const Map &other) {
 		if (this != &other) {
 			Map temp(other);
-			std::swap(this->_head, temp._head);
-			std::swap(this->_size, temp._size);
+			swap(temp);
 		}
 		return *this;
 	}
@@ -235,6 +851,8 @@ public:
 	/**
 		@brief Funzione per svuotare la struttura dati.
 
+		Vengono deallocati anche i nodi preallocati con reserve.
+
 		@post _head == nullptr
 		@post _size == 0
   	*/
@@ -247,14 +865,159 @@ public:
 		// l'aggiunta delle coppie nella mappa
 		while (current != nullptr) {
 			Node *cnext = current->next;
-			delete current;
+			delete_node(current);
 			current = cnext;
 		}
 
+		release_slabs();
 		_head = nullptr;
 		_size = 0;
 	}
 
+	/**
+		@brief Prealloca lo spazio per un certo numero di coppie.
+
+		I nodi mancanti vengono allocati in un unico blocco contiguo e
+		usati dalle successive aggiunte, che così non richiedono ulteriori
+		allocazioni e producono nodi vicini in memoria.
+
+		@param n numero di coppie che la mappa deve poter contenere
+		@throw se l'allocazione delle risorse fallisce lancia un'eccezione
+  	*/
+	void reserve(unsigned int n) {
+		if (n > _size + _free_count)
+			add_slab(n - _size - _free_count);
+	}
+
+	/**
+		@brief Compatta la mappa in un unico blocco contiguo.
+
+		Le coppie vengono copiate, nell'ordine della lista, in un nuovo
+		blocco di esattamente size() nodi e i vecchi nodi vengono
+		deallocati, compresi quelli preallocati e non usati. Ripristina
+		la località degli accessi dopo molte rimozioni.
+		Invalida tutti gli iteratori.
+
+		@throw se l'allocazione o la copia falliscono lancia un'eccezione
+		e la mappa resta invariata
+  	*/
+	void compact() {
+		if (_size == 0) {
+			release_slabs();
+			return;
+		}
+
+		std::vector<Slab> fresh;
+		fresh.reserve(1);
+		Node *mem = allocate_nodes(_size);
+		unsigned int built = 0;
+
+		try {
+			for (Node *current = _head; current != nullptr; current = current->next) {
+				Node *n = new (mem + built) Node(current->item, nullptr);
+				n->set_hash(current->get_hash());
+				if (built > 0)
+					mem[built - 1].next = n;
+				built++;
+			}
+		} catch(...) {
+			for (unsigned int i = 0; i < built; ++i)
+				mem[i].~Node();
+			deallocate_nodes(mem);
+			throw;
+		}
+
+		Node *current = _head;
+		while (current != nullptr) {
+			Node *cnext = current->next;
+			delete_node(current);
+			current = cnext;
+		}
+		release_slabs();
+
+		fresh.push_back(Slab{mem, _size});
+		_slabs.swap(fresh);
+		_head = mem;
+	}
+
+	/**
+		@brief Restituisce la memoria preallocata non utilizzata.
+
+		Vengono deallocati i blocchi i cui nodi sono tutti liberi. A
+		differenza di compact() nessuna coppia viene spostata, per cui
+		gli iteratori restano validi.
+  	*/
+	void shrink_to_fit() {
+		std::vector<unsigned int> free_in(_slabs.size(), 0);
+		for (void *p = _free; p != nullptr; p = *static_cast<void **>(p))
+			free_in[slab_of(p)]++;
+
+		// Ricostruisco la lista dei liberi senza i nodi dei blocchi vuoti
+		void *p = _free;
+		_free = nullptr;
+		_free_count = 0;
+		while (p != nullptr) {
+			void *pnext = *static_cast<void **>(p);
+			int i = slab_of(p);
+			if (free_in[i] != _slabs[i].capacity) {
+				*static_cast<void **>(p) = _free;
+				_free = p;
+				_free_count++;
+			}
+			p = pnext;
+		}
+
+		std::size_t kept = 0;
+		for (std::size_t i = 0; i < _slabs.size(); ++i) {
+			if (free_in[i] == _slabs[i].capacity)
+				deallocate_nodes(_slabs[i].mem);
+			else
+				_slabs[kept++] = _slabs[i];
+		}
+		_slabs.resize(kept);
+	}
+
+	/**
+		@brief Occupazione di memoria della mappa.
+
+		La memoria è suddivisa tra struttura (l'oggetto Map, i puntatori
+		e gli hash memorizzati nei nodi, una stima dell'overhead
+		dell'allocatore per i nodi allocati singolarmente), dati (le
+		coppie e la memoria dinamica da esse posseduta, vedi
+		map_heap_bytes) e nodi preallocati non ancora usati.
+
+		@return occupazione di memoria in byte
+  	*/
+	MemoryUsage memory_usage() const {
+		// Un nodo allocato singolarmente occupa anche l'intestazione
+		// dell'allocatore ed è arrotondato a multipli di 16 byte
+		const std::size_t heap_node = (sizeof(Node) + sizeof(void *) + 15) / 16 * 16;
+		const std::size_t node_overhead = sizeof(Node) - sizeof(Pair<C, V>);
+		MemoryUsage m;
+
+		m.structure = sizeof(Map) + _slabs.capacity() * sizeof(Slab);
+		for (const Node *current = _head; current != nullptr; current = current->next) {
+			m.structure += node_overhead;
+			if (slab_of(current) < 0)
+				m.structure += heap_node - sizeof(Node);
+
+			m.payload += sizeof(Pair<C, V>) + map_heap_bytes(current->item.key) +
+				map_heap_bytes(current->item.value);
+		}
+		m.reserved = static_cast<std::size_t>(_free_count) * sizeof(Node);
+		m.total = m.structure + m.payload + m.reserved;
+
+		return m;
+	}
+
+	/**
+		@return numero di coppie che la mappa può contenere senza
+		ulteriori allocazioni di nodi
+	*/
+	unsigned int capacity() const {
+		return _size + _free_count;
+	}
+
 	/**
 		@brief Funzione che aggiunge una coppia alla mappa.
 
@@ -276,32 +1039,82 @@ public:
 		keyAlreadyDefinedException)
   	*/
 	void add(const C &k, const V &v) {
+		std::size_t h = _fhash(k);
+
+		// Controllo se la chiave è già presente prima di allocare
+		// il nodo, così in caso di eccezione non resta nulla da
+		// deallocare. Su lista vuota la ricerca termina subito
+		if (find_node(k, h, _head) != nullptr) {
+			throw keyAlreadyDefinedException("Chiave già presente nella mappa.");
+		}
+
 		// Non racchiudo in un blocco try-catch perché
 		// se l'allocazione di risorse fallisce non c'è
 		// possibilità di gestire diversamente l'errore
-		Node *temp = new Node(Pair<C, V>(k, v));
+		Node *temp = new_node(Pair<C, V>(k, v), _head, h);
 
-		// Controllo caso lista vuota
-		// Se la lista è vuota, la chiave non è già presente
-		// e il nodo può essere aggiunto in testa
-		if (_size == 0) {
-			_head = temp;
-			_size = 1;
-			return;
-		}
-		
-		// Se la lista non è vuota, controllo se la chiave
-		// è già presente. Se non è presente, inserisco in testa
-		if (exists(k)){
-			throw keyAlreadyDefinedException("Chiave già presente nella mappa.");
-		} else {
-			Node *current = _head;
-			_head = temp;
-			temp->next = current;
-			_size++;
-			return;
+		// Inserimento in testa
+		_head = temp;
+		_size++;
+	}
+
+#ifdef __cpp_impl_coroutine
+	/**
+		@brief Ricerca asincrona di una chiave (C++20).
+
+		Coroutine che percorre la lista come value(), ma prima di
+		accedere ad ogni nodo ne richiede il prefetch e cede il turno
+		allo scheduler. Avviando molte ricerche indipendenti sullo stesso
+		scheduler, i cache miss di una ricerca vengono coperti dal lavoro
+		delle altre. Si usa all'interno di una coroutine con
+		co_await map.async_find(chiave, scheduler).
+
+		La mappa non deve essere modificata finché la ricerca non è
+		terminata.
+
+		@param key chiave della coppia (copiata nella coroutine)
+		@param sched scheduler che esegue la ricerca
+		@return puntatore al valore associato alla chiave, nullptr se
+		la chiave non è presente
+  	*/
+	LookupTask<const V *> async_find(C key, LookupScheduler &sched) const {
+		std::size_t h = _fhash(key);
+
+		for (const Node *current = _head; current != nullptr; current = current->next) {
+#if defined(__GNUC__)
+			__builtin_prefetch(current);
+#endif
+			co_await sched.yield();
+
+			if (matches(current, key, h))
+				co_return &current->item.value;
 		}
-		
+
+		co_return nullptr;
+	}
+#endif
+
+	/**
+		@brief Aggiunge una coppia senza verificare se la chiave è
+		già presente.
+
+		Pensata per il caricamento di coppie le cui chiavi sono già
+		note come distinte (ad esempio da un'altra mappa o da uno
+		snapshot su file), evitando la scansione della lista di add.
+
+		@param k chiave della coppia
+		@param v valore della coppia
+
+		@pre nessuna coppia della mappa ha chiave k
+		@post _size = _size + 1
+
+		@throw se l'allocazione delle risorse fallisce lancia un'eccezione
+  	*/
+	void add_unchecked(const C &k, const V &v) {
+		Node *temp = new_node(Pair<C, V>(k, v), _head, _fhash(k));
+
+		_head = temp;
+		_size++;
 	}
 
 	/**
@@ -315,13 +1128,14 @@ public:
   	*/
 	bool exists(const C &key) const {
 		Node *current = _head;
+		std::size_t h = _fhash(key);
 
 		// Ciclo su tutti i nodi della lista per verificare,
 		// con l'ausilio del funtore di uguaglianza tra tipi C,
 		// se è presente nella mappa una coppia con la chiave 
 		// passata come parametro
 		while (current != nullptr) {
-			if (_fequal(key, current->item.key))
+			if (matches(current, key, h))
 				return true;
 			current = current->next;
 		}
@@ -348,9 +1162,10 @@ public:
 		
 		Node *current = _head;
 		Node *previous = _head;
+		std::size_t h = _fhash(key);
 
 		while(current != nullptr) {
-			if (_fequal(key, current->item.key)) {
+			if (matches(current, key, h)) {
 				
 				// Caso di rimozione in testa
 				if (current == _head) {
@@ -359,7 +1174,7 @@ public:
 
 				// Passi di rimozione comuni
 				previous->next = current->next;
-				delete current;
+				delete_node(current);
 				current = nullptr;
 				_size--;
 
@@ -391,14 +1206,363 @@ public:
 		}
 
 		Node *current = _head;
+		std::size_t h = _fhash(key);
 
 		while (current != nullptr) {
-			if (_fequal(key, current->item.key))
+			if (matches(current, key, h))
 				return current->item.value;
 			current = current->next;
 		}
 	}
 	
+	/**
+		@brief Sposta nella mappa le coppie di un'altra mappa.
+
+		I nodi di other le cui chiavi non sono presenti in this vengono
+		scollegati da other e collegati in testa a this, senza allocare
+		né copiare le coppie. Le coppie con chiave già presente in this
+		restano in other (come in std::unordered_map::merge).
+		Le chiavi di other sono distinte tra loro, quindi ogni chiave
+		viene confrontata solo con le coppie presenti in this prima
+		della chiamata.
+		I nodi che si trovano in un blocco preallocato di other (vedi
+		reserve) non possono cambiare proprietario e vengono copiati.
+		Con un funtore di hash le coppie di this vengono indicizzate in
+		una tabella hash, per un tempo atteso lineare; altrimenti ogni
+		chiave di other viene cercata scorrendo this.
+
+		@param other mappa da cui spostare le coppie
+		@throw se l'allocazione dell'indice fallisce rilancia l'eccezione,
+		lasciando invariate entrambe le mappe
+
+		@post _size + other._size invariato
+  	*/
+	void merge(Map &other) {
+		if (this == &other)
+			return;
+
+		Node *original = _head; // prima coppia presente prima del merge
+		// Indice delle sole coppie presenti prima del merge: i nodi
+		// spostati vengono collegati in testa e non ne fanno parte
+		KeyIndex<Node *> index = node_index();
+		Node *current = other._head;
+		Node *previous = nullptr;
+
+		while (current != nullptr) {
+			Node *cnext = current->next;
+
+			if (lookup(index, current->item.key, current->get_hash(), original) != nullptr) {
+				// Conflitto: il nodo resta in other
+				previous = current;
+			} else {
+				// Scollego il nodo da other...
+				if (other.slab_of(current) >= 0) {
+					_head = new_node(current->item, _head, current->get_hash());
+					other.unlink(previous, current);
+				} else {
+					if (previous == nullptr)
+						other._head = cnext;
+					else
+						previous->next = cnext;
+					other._size--;
+
+					// ... e lo collego in testa a this
+					current->next = _head;
+					_head = current;
+				}
+				_size++;
+			}
+
+			current = cnext;
+		}
+	}
+
+	/**
+		@brief Sposta nella mappa le coppie di una mappa temporanea.
+
+		@param other mappa da cui spostare le coppie
+		@see merge(Map &)
+  	*/
+	void merge(Map &&other) {
+		merge(other);
+	}
+
+	/**
+		@brief Unione con un'altra mappa.
+
+		Le coppie di other con chiave non presente in this vengono
+		aggiunte; per le chiavi presenti in entrambe il valore di this
+		viene sostituito da resolve(chiave, valore di this, valore di other).
+		Con un funtore di hash le chiavi di this vengono indicizzate in
+		una tabella temporanea e il costo atteso è lineare; senza, ogni
+		coppia di other viene cercata scorrendo this.
+
+		I nuovi nodi e i valori risolti vengono preparati a parte e
+		applicati solo alla fine: se resolve o un'allocazione lanciano
+		un'eccezione la mappa resta invariata (purché non lanci
+		l'assegnamento di V, eseguito nell'ultima fase).
+
+		@param other mappa da unire
+		@param resolve funzione di risoluzione dei conflitti
+
+		@throw rilancia le eccezioni di resolve e delle allocazioni
+  	*/
+	template <typename F>
+	void union_with(const Map &other, F resolve) {
+		if (this == &other)
+			return;
+
+		KeyIndex<Node *> index = node_index();
+		std::vector<std::pair<Node *, V>> resolved;
+		Node *added = nullptr; // nuovi nodi, nell'ordine in cui andranno in testa
+		Node *last = nullptr; // ultimo dei nuovi nodi
+		unsigned int count = 0;
+
+		try {
+			for (const Node *current = other._head; current != nullptr; current = current->next) {
+				Node *found = lookup(index, current->item.key, current->get_hash(), _head);
+
+				if (found != nullptr) {
+					resolved.emplace_back(found, resolve(found->item.key, found->item.value, current->item.value));
+				} else {
+					added = new_node(current->item, added, current->get_hash());
+					if (last == nullptr)
+						last = added;
+					count++;
+				}
+			}
+		} catch(...) {
+			while (added != nullptr) {
+				Node *next = added->next;
+				delete_node(added);
+				added = next;
+			}
+			throw;
+		}
+
+		for (std::pair<Node *, V> &r : resolved)
+			r.first->item.value = std::move(r.second);
+
+		if (added != nullptr) {
+			last->next = _head;
+			_head = added;
+			_size += count;
+		}
+	}
+
+	/**
+		@brief Intersezione con un'altra mappa.
+
+		Vengono mantenute solo le coppie la cui chiave è presente anche in
+		other; il loro valore diventa resolve(chiave, valore di this,
+		valore di other). Con un funtore di hash le chiavi di other
+		vengono indicizzate in una tabella temporanea e il costo atteso è
+		lineare. Se resolve lancia un'eccezione le coppie già elaborate
+		restano modificate.
+
+		@param other mappa da intersecare
+		@param resolve funzione di risoluzione dei conflitti
+  	*/
+	template <typename F>
+	void intersect_with(const Map &other, F resolve) {
+		if (this == &other)
+			return;
+
+		KeyIndex<Node *> index = other.node_index();
+		Node *current = _head;
+		Node *previous = nullptr;
+
+		while (current != nullptr) {
+			Node *cnext = current->next;
+			const Node *found = other.lookup(index, current->item.key, current->get_hash(), other._head);
+
+			if (found != nullptr) {
+				current->item.value = resolve(current->item.key, current->item.value, found->item.value);
+				previous = current;
+			} else {
+				unlink(previous, current);
+			}
+
+			current = cnext;
+		}
+	}
+
+	/**
+		@brief Differenza con un'altra mappa.
+
+		Rimuove da this tutte le coppie la cui chiave è presente in other.
+		Con un funtore di hash le chiavi di other vengono indicizzate in
+		una tabella temporanea e il costo atteso è lineare.
+
+		@param other mappa da sottrarre
+  	*/
+	void difference(const Map &other) {
+		if (this == &other) {
+			clear();
+			return;
+		}
+
+		KeyIndex<Node *> index = other.node_index();
+		Node *current = _head;
+		Node *previous = nullptr;
+
+		while (current != nullptr) {
+			Node *cnext = current->next;
+
+			if (other.lookup(index, current->item.key, current->get_hash(), other._head) != nullptr)
+				unlink(previous, current);
+			else
+				previous = current;
+
+			current = cnext;
+		}
+	}
+
+	/**
+		@brief Applica un blocco di scritture in un'unica passata.
+
+		Per ogni chiave conta solo l'ultima operazione del blocco: le
+		precedenti vengono scartate. Le operazioni vengono indicizzate
+		per hash in una tabella ad indirizzamento aperto, poi la lista
+		viene percorsa una sola volta (fermandosi quando tutte le chiavi
+		del blocco sono state trovate) aggiornando o rimuovendo i nodi
+		corrispondenti; infine le put rimaste vengono inserite in testa,
+		nell'ordine del blocco.
+
+		Con un funtore di hash il costo è lineare nella somma delle
+		dimensioni della mappa e del blocco, invece di una ricerca
+		completa per ogni operazione. Senza funtore di hash la passata
+		resta unica ma ogni nodo viene confrontato con le chiavi del
+		blocco tramite Eq.
+
+		A differenza di add, una put su una chiave presente ne sostituisce
+		il valore e una erase su una chiave assente non ha effetto, dato
+		che le operazioni di un blocco non possono segnalare errori
+		singolarmente.
+
+		@param ops operazioni, nell'ordine in cui sono state richieste
+		@return numero di coppie aggiunte, aggiornate e rimosse
+		@throw se l'allocazione o la copia falliscono lancia un'eccezione;
+		le operazioni già applicate restano applicate
+  	*/
+	BatchResult apply_batch(const std::vector<BatchOp<C, V>> &ops) {
+		BatchResult result;
+		if (ops.empty())
+			return result;
+
+		std::size_t mask = 1;
+		while (mask < ops.size() * 2)
+			mask <<= 1;
+		mask--;
+
+		// Hash rimescolato moltiplicando per una costante dispersiva, così
+		// anche hash poco uniformi vanno bene: i bit centrali danno la
+		// posizione iniziale nella tabella, i 6 bit alti un filtro a 64
+		// bit che scarta subito la maggior parte dei nodi se il blocco
+		// contiene poche chiavi
+		auto mix = [](std::size_t h) {
+			return static_cast<std::uint64_t>(h) * 0x9e3779b97f4a7c15ULL;
+		};
+		auto start = [mask](std::uint64_t x) {
+			return static_cast<std::size_t>(x >> 32) & mask;
+		};
+
+		std::vector<std::size_t> hashes(ops.size());
+		std::vector<int> table(mask + 1, -1); // indice dell'ultima operazione per chiave
+		std::vector<char> pending(ops.size(), 0);
+		std::size_t keys = 0;
+		std::uint64_t filter = 0;
+
+		for (std::size_t i = 0; i < ops.size(); ++i) {
+			hashes[i] = _fhash(ops[i].key);
+			std::uint64_t x = mix(hashes[i]);
+			filter |= std::uint64_t(1) << (x >> 58);
+			std::size_t p = start(x);
+			while (table[p] >= 0 && !(hashes[table[p]] == hashes[i] && _fequal(ops[table[p]].key, ops[i].key)))
+				p = (p + 1) & mask;
+
+			if (table[p] >= 0) {
+				pending[table[p]] = 0;
+				result.discarded++;
+			} else {
+				keys++;
+			}
+			table[p] = static_cast<int>(i);
+			pending[i] = 1;
+		}
+
+		Node *current = _head;
+		Node *previous = nullptr;
+
+		while (current != nullptr && keys > 0) {
+			Node *cnext = current->next;
+			std::size_t h = current->get_hash();
+			std::uint64_t x = mix(h);
+			int found = -1;
+
+			if (!(filter & (std::uint64_t(1) << (x >> 58)))) {
+				previous = current;
+				current = cnext;
+				continue;
+			}
+
+			std::size_t p = start(x);
+
+			for (; table[p] >= 0; p = (p + 1) & mask) {
+				if (hashes[table[p]] == h && _fequal(ops[table[p]].key, current->item.key)) {
+					found = table[p];
+					break;
+				}
+			}
+
+			if (found >= 0) {
+				pending[found] = 0;
+				keys--;
+				if (ops[found].type == BatchOp<C, V>::put) {
+					current->item.value = ops[found].value;
+					result.updated++;
+					previous = current;
+				} else {
+					unlink(previous, current);
+					result.removed++;
+				}
+			} else {
+				previous = current;
+			}
+
+			current = cnext;
+		}
+
+		unsigned int inserts = 0;
+		for (std::size_t i = 0; i < ops.size(); ++i)
+			if (pending[i] && ops[i].type == BatchOp<C, V>::put)
+				inserts++;
+
+		// I nuovi nodi vengono presi da un blocco contiguo. Il blocco
+		// cresce in proporzione ai blocchi esistenti, per non crearne
+		// uno per ogni batch, ma al più di 16 volte la dimensione del
+		// batch e di max_batch_slab nodi: la memoria riservata non
+		// dipende dalla dimensione della mappa
+		if (inserts > _free_count) {
+			unsigned int missing = inserts - _free_count;
+			std::size_t slabbed = 0;
+			for (const Slab &slab : _slabs)
+				slabbed += slab.capacity;
+			std::size_t growth = std::min<std::size_t>({slabbed / 2, ops.size() * 16, max_batch_slab});
+			add_slab(static_cast<unsigned int>(std::max<std::size_t>(missing, growth)));
+		}
+
+		for (std::size_t i = 0; i < ops.size(); ++i) {
+			if (pending[i] && ops[i].type == BatchOp<C, V>::put) {
+				_head = new_node(Pair<C, V>(ops[i].key, ops[i].value), _head, hashes[i]);
+				_size++;
+				result.inserted++;
+			}
+		}
+
+		return result;
+	}
+
 	/**
 		Funzione globale che implementa l'operatore di stream
 		(non richiesto esplicitamente, implementato per debug).
@@ -416,10 +1580,12 @@ public:
 		Node *current = map._head;
 		int count = 1;
 
+		// Si usa '\n' e non std::endl per non forzare il flush dello
+		// stream ad ogni riga; per grandi volumi usare MapExporter
 		while(current != nullptr) {
-			os << count << ")" << std::endl;
-			os << "Chiave: " << current->item.key << std::endl;
-			os << "Valore: " << current->item.value << std::endl;
+			os << count << ")" << '\n';
+			os << "Chiave: " << current->item.key << '\n';
+			os << "Valore: " << current->item.value << '\n';
 			current = current->next;
 			count++;
 		}
@@ -441,6 +1607,9 @@ public:
 		const_iterator b, e;
 		std::vector<C> v;
 
+		// Il numero di chiavi è noto, si evitano le riallocazioni
+		v.reserve(_size);
+
 		for (b = begin(), e = end(); b != e; ++b) {
 			v.push_back((*b).key);
 		}
@@ -448,6 +1617,261 @@ public:
 		return v;
 	}
 
+	/**
+		@brief Restituisce un vettore con le chiavi della mappa,
+		riempito in parallelo.
+
+		La lista viene percorsa una sola volta per raccogliere i nodi,
+		dopodiché la copia delle chiavi viene suddivisa tra i thread del
+		pool. Conviene per chiavi costose da copiare (es. stringhe).
+
+		@param pool pool di thread da utilizzare
+		@return std::vector<C> con le chiavi nello stesso ordine di keys()
+	*/
+	std::vector<C> keys(ThreadPool &pool) const {
+		std::vector<const Node *> n = nodes();
+		std::vector<C> v(n.size());
+
+		for_chunks(pool, n.size(), [&n, &v](std::size_t b, std::size_t e) {
+			for (std::size_t i = b; i < e; ++i)
+				v[i] = n[i]->item.key;
+		});
+		
+		return v;
+	}
+
+	/**
+		@brief Restituisce un vettore con i valori della mappa.
+
+		@return std::vector<V> con i valori nello stesso ordine di keys()
+	*/
+	std::vector<V> values() const {
+		const_iterator b, e;
+		std::vector<V> v;
+
+		v.reserve(_size);
+
+		for (b = begin(), e = end(); b != e; ++b) {
+			v.push_back((*b).value);
+		}
+		
+		return v;
+	}
+
+	/**
+		@brief Restituisce un vettore con i valori della mappa,
+		riempito in parallelo.
+
+		@param pool pool di thread da utilizzare
+		@return std::vector<V> con i valori nello stesso ordine di keys()
+	*/
+	std::vector<V> values(ThreadPool &pool) const {
+		std::vector<const Node *> n = nodes();
+		std::vector<V> v(n.size());
+
+		for_chunks(pool, n.size(), [&n, &v](std::size_t b, std::size_t e) {
+			for (std::size_t i = b; i < e; ++i)
+				v[i] = n[i]->item.value;
+		});
+		
+		return v;
+	}
+
+	/**
+		@brief Applica una funzione a tutte le coppie in parallelo.
+
+		La funzione viene invocata come fn(chiave, valore) con la chiave
+		costante e il valore modificabile. Coppie diverse vengono
+		elaborate da thread diversi, quindi fn deve essere thread-safe
+		rispetto allo stato che condivide tra le invocazioni.
+
+		@param fn funzione da applicare
+		@param pool pool di thread da utilizzare
+		@throw rilancia la prima eccezione sollevata da fn
+	*/
+	template <typename F>
+	void parallel_for_each(F fn, ThreadPool &pool) {
+		std::vector<const Node *> n = nodes();
+
+		for_chunks(pool, n.size(), [&n, &fn](std::size_t b, std::size_t e) {
+			for (std::size_t i = b; i < e; ++i) {
+				Node *current = const_cast<Node *>(n[i]);
+				fn(static_cast<const C &>(current->item.key), current->item.value);
+			}
+		});
+	}
+
+	/**
+		@brief Applica una funzione a tutte le coppie in parallelo
+		(versione costante).
+
+		@param fn funzione da applicare, invocata come fn(chiave, valore)
+		@param pool pool di thread da utilizzare
+		@throw rilancia la prima eccezione sollevata da fn
+	*/
+	template <typename F>
+	void parallel_for_each(F fn, ThreadPool &pool) const {
+		std::vector<const Node *> n = nodes();
+
+		for_chunks(pool, n.size(), [&n, &fn](std::size_t b, std::size_t e) {
+			for (std::size_t i = b; i < e; ++i)
+				fn(n[i]->item.key, n[i]->item.value);
+		});
+	}
+
+	/**
+		@brief Aggiunge alla mappa una sequenza di coppie in parallelo.
+
+		Equivale a chiamare add su ogni coppia della sequenza [first, last)
+		nell'ordine dato, ma la verifica dei duplicati e l'allocazione dei
+		nodi vengono suddivise tra i thread del pool. Solo il collegamento
+		finale dei nodi alla lista è sequenziale.
+		Con un funtore di hash le chiavi della sequenza e della mappa
+		vengono suddivise per hash in partizioni indipendenti, verificate
+		in parallelo con una tabella hash ciascuna: il costo atteso è
+		lineare. Senza funtore di hash la verifica dei duplicati usa il
+		funtore di uguaglianza: il costo complessivo resta quadratico, ma
+		viene diviso per il numero di thread.
+
+		@param first iteratore ad accesso casuale al primo Pair<C, V>
+		@param last iteratore ad accesso casuale oltre l'ultimo Pair<C, V>
+		@param pool pool di thread da utilizzare
+
+		@post _size = _size + (last - first)
+
+		@throw keyAlreadyDefinedException se una chiave è già presente
+		nella mappa o ripetuta nella sequenza; se l'allocazione fallisce
+		rilancia l'eccezione. In entrambi i casi la mappa resta invariata.
+	*/
+	template <typename RandomIt>
+	void parallel_build(RandomIt first, RandomIt last, ThreadPool &pool) {
+		std::size_t count = static_cast<std::size_t>(last - first);
+		std::vector<Node *> n(count, nullptr);
+		std::vector<std::size_t> hs(count);
+		std::atomic<bool> duplicate(false);
+
+		// Gli hash delle chiavi vengono calcolati una volta sola
+		for_chunks(pool, count, [&](std::size_t b, std::size_t e) {
+			for (std::size_t i = b; i < e; ++i)
+				hs[i] = _fhash(first[i].key);
+		});
+
+		try {
+			if (hashed) {
+				build_partitioned(first, hs, n, duplicate, pool);
+			} else {
+				for_chunks(pool, count, [&](std::size_t b, std::size_t e) {
+					for (std::size_t i = b; i < e && !duplicate; ++i) {
+						const C &key = first[i].key;
+
+						bool found = find_node(key, hs[i], _head) != nullptr;
+						for (std::size_t j = 0; j < i && !found; ++j)
+							found = (!hashed || hs[j] == hs[i]) && _fequal(key, first[j].key);
+
+						if (found) {
+							duplicate = true;
+							return;
+						}
+
+						n[i] = new Node(Pair<C, V>(key, first[i].value));
+						n[i]->set_hash(hs[i]);
+					}
+				});
+			}
+		} catch(...) {
+			for (Node *current : n)
+				delete current; // recovery degli errori
+			throw;
+		}
+
+		if (duplicate) {
+			for (Node *current : n)
+				delete current;
+			throw keyAlreadyDefinedException("Chiave già presente nella mappa.");
+		}
+
+		// Come per add, ogni nuova coppia viene inserita in testa
+		for (std::size_t i = 0; i < count; ++i) {
+			n[i]->next = _head;
+			_head = n[i];
+		}
+		_size += static_cast<unsigned int>(count);
+	}
+
+	/**
+		Iteratore forward non costante sulle coppie della mappa.
+		Consente di modificare in loco i valori delle coppie; il
+		dereferenziamento restituisce un PairRef, per cui la chiave è
+		accessibile solo in lettura.
+	*/
+	class iterator {
+		//	
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef Pair<C, V>                value_type;
+		typedef ptrdiff_t                 difference_type;
+		typedef PairRef<C, V>             pointer;
+		typedef PairRef<C, V>             reference;
+
+	
+		iterator() : nptr(nullptr) {}
+		
+		iterator(const iterator &other) : nptr(other.nptr) {}
+
+		iterator& operator=(const iterator &other) {
+			nptr = other.nptr;
+			return *this;
+		}
+
+		~iterator() {}
+
+		// Ritorna il dato riferito dall'iteratore (dereferenziamento)
+		reference operator*() const {
+			return reference(nptr->item.key, nptr->item.value);
+		}
+
+		// Ritorna il riferimento al dato, su cui si applica a sua volta
+		// l'operatore freccia
+		pointer operator->() const {
+			return **this;
+		}
+		
+		// Operatore di iterazione post-incremento
+		iterator operator++(int) {
+			iterator temp(*this);
+			nptr = nptr->next;
+			return temp;
+		}
+
+		// Operatore di iterazione pre-incremento
+		iterator& operator++() {
+			nptr = nptr->next;
+			return *this;
+		}
+
+		// Uguaglianza
+		bool operator==(const iterator &other) const {
+			return (nptr == other.nptr);
+		}
+		
+		// Diversita'
+		bool operator!=(const iterator &other) const {
+			return (nptr != other.nptr);
+		}
+
+	private:
+		//Dati membro
+
+		friend class Map;
+		friend class const_iterator;
+
+		// Costruttore privato di inizializzazione usato dalla classe container
+		iterator(Node *n) : nptr(n) { }
+
+		Node *nptr;
+		
+	}; // classe iterator
+
 	/**
 		La classe Map deve supportare l'accesso ai dati tramite 
 		iteratori forward costanti. Gli iteratori iterano sulle 
@@ -470,6 +1894,9 @@ public:
 		
 		const_iterator(const const_iterator &other) : nptr(other.nptr) {}
 
+		// Conversione da iteratore non costante
+		const_iterator(const iterator &other) : nptr(other.nptr) {}
+
 		const_iterator& operator=(const const_iterator &other) {
 			nptr = other.nptr;
 			return *this;
@@ -535,6 +1962,167 @@ public:
 		return const_iterator(nullptr);
 	}
 
+	// Ritorna l'iteratore non costante all'inizio della sequenza dati
+	iterator begin() {
+		return iterator(_head);
+	}
+	
+	// Ritorna l'iteratore non costante alla fine della sequenza dati
+	iterator end() {
+		return iterator(nullptr);
+	}
+
+	/**
+		@brief Cerca la coppia con una certa chiave.
+
+		@param key chiave della coppia
+		@return iteratore alla coppia, end() se la chiave non è presente
+  	*/
+	iterator find(const C &key) {
+		return iterator(find_node(key, _fhash(key), _head));
+	}
+
+	/**
+		@brief Cerca la coppia con una certa chiave (versione costante).
+
+		@param key chiave della coppia
+		@return iteratore alla coppia, end() se la chiave non è presente
+  	*/
+	const_iterator find(const C &key) const {
+		return const_iterator(find_node(key, _fhash(key), _head));
+	}
+
+	/**
+		Iteratore forward su un solo campo delle coppie (la chiave o
+		il valore), usato dalle viste keys_view e values_view.
+		Scorre direttamente i nodi della lista senza copiare i dati.
+
+		@tparam T tipo del campo riferito (eventualmente const)
+		@tparam N tipo del nodo (const Node per gli iteratori costanti)
+		@tparam IsKey true per iterare sulle chiavi, false sui valori
+	*/
+	template <typename T, typename N, bool IsKey>
+	class field_iterator {
+		//
+	public:
+		typedef std::forward_iterator_tag          iterator_category;
+		typedef typename std::remove_const<T>::type value_type;
+		typedef ptrdiff_t                          difference_type;
+		typedef T*                                 pointer;
+		typedef T&                                 reference;
+
+		field_iterator() : nptr(nullptr) {}
+
+		// Ritorna il campo riferito dall'iteratore (dereferenziamento)
+		reference operator*() const {
+			if constexpr (IsKey)
+				return nptr->item.key;
+			else
+				return nptr->item.value;
+		}
+
+		// Ritorna il puntatore al campo riferito dall'iteratore
+		pointer operator->() const {
+			return &(**this);
+		}
+
+		// Operatore di iterazione post-incremento
+		field_iterator operator++(int) {
+			field_iterator temp(*this);
+			nptr = nptr->next;
+			return temp;
+		}
+
+		// Operatore di iterazione pre-incremento
+		field_iterator& operator++() {
+			nptr = nptr->next;
+			return *this;
+		}
+
+		// Uguaglianza
+		bool operator==(const field_iterator &other) const {
+			return (nptr == other.nptr);
+		}
+
+		// Diversita'
+		bool operator!=(const field_iterator &other) const {
+			return (nptr != other.nptr);
+		}
+
+	private:
+		friend class Map;
+
+		// Costruttore privato di inizializzazione usato dalla classe container
+		explicit field_iterator(N *n) : nptr(n) { }
+
+		N *nptr;
+
+	}; // classe field_iterator
+
+	// Iteratore costante sulle chiavi
+	typedef field_iterator<const C, const Node, true> key_iterator;
+	// Iteratore costante sui valori
+	typedef field_iterator<const V, const Node, false> const_value_iterator;
+	// Iteratore non costante sui valori
+	typedef field_iterator<V, Node, false> value_iterator;
+
+	/**
+		Vista "pigra" su una sequenza della mappa: non possiede né copia
+		i dati, ma espone solo la coppia di iteratori begin/end in modo
+		da poter essere usata nei range-for e con gli algoritmi standard.
+		La vista resta valida finché la mappa non viene modificata.
+	*/
+	template <typename I>
+	class view {
+	public:
+		typedef I iterator;
+
+		view(I b, I e, unsigned int n) : _b(b), _e(e), _n(n) {}
+
+		I begin() const { return _b; }
+
+		I end() const { return _e; }
+
+		unsigned int size() const { return _n; }
+
+		bool empty() const { return _n == 0; }
+
+	private:
+		I _b, _e; // estremi della sequenza
+		unsigned int _n; // numero di elementi
+	}; // classe view
+
+	/**
+		@brief Vista sulle chiavi della mappa.
+
+		A differenza di keys() non alloca né copia nulla.
+
+		@return vista costante sulle chiavi
+	*/
+	view<key_iterator> keys_view() const {
+		return view<key_iterator>(key_iterator(_head), key_iterator(nullptr), _size);
+	}
+
+	/**
+		@brief Vista costante sui valori della mappa.
+
+		@return vista costante sui valori
+	*/
+	view<const_value_iterator> values_view() const {
+		return view<const_value_iterator>(const_value_iterator(_head),
+			const_value_iterator(nullptr), _size);
+	}
+
+	/**
+		@brief Vista sui valori della mappa che ne consente la modifica
+		in loco.
+
+		@return vista non costante sui valori
+	*/
+	view<value_iterator> values_view() {
+		return view<value_iterator>(value_iterator(_head), value_iterator(nullptr), _size);
+	}
+
 }; // classe map
 
 #endif
\ No newline at end of file
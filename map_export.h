@@ -0,0 +1,293 @@
+#ifndef MAP_EXPORT_H
+#define MAP_EXPORT_H
+
+#include <string> // std::string
+#include <sstream> // std::ostringstream
+#include <ostream> // std::ostream
+#include <charconv> // std::to_chars
+#include <type_traits> // std::is_arithmetic, std::is_floating_point
+#include <cmath> // std::isfinite
+#include <cerrno> // errno
+#include <unistd.h> // ::write
+#include "map.h"
+#include "io_exception.h" // eccezione custom per gli errori di scrittura
+
+/**
+	@brief Classe MapExporter
+
+	Esportazione massiva del contenuto di una Map in formato CSV/TSV o
+	JSON-lines. Le coppie vengono formattate in un buffer interno, che
+	viene riutilizzato tra una chiamata e l'altra, e scritte sulla
+	destinazione un blocco alla volta: la memoria occupata è limitata
+	dalla dimensione del blocco e non da quella della mappa, per cui
+	l'esportazione funziona anche per output più grandi della memoria.
+
+	I tipi numerici vengono convertiti con std::to_chars, le stringhe
+	vengono copiate direttamente e gli altri tipi vengono scritti
+	tramite il loro operatore di stream. Il tipo char è trattato come
+	testo di un carattere e non come numero.
+*/
+class MapExporter {
+public:
+	/**
+		Costruttore
+
+		@param chunk dimensione in byte dei blocchi scritti sulla
+		destinazione
+	*/
+	explicit MapExporter(std::size_t chunk = 1 << 16) : _chunk(chunk) {
+		_buf.reserve(chunk + 256);
+	}
+
+	/**
+		@brief Esporta la mappa in formato CSV (o TSV) su uno stream.
+
+		Ogni coppia è scritta su una riga "chiave<sep>valore". I campi
+		testuali che contengono il separatore, virgolette o a capo
+		vengono racchiusi tra virgolette come da RFC 4180.
+
+		@param os stream di output
+		@param map mappa da esportare
+		@param sep separatore dei campi (',' per CSV, '\t' per TSV)
+	*/
+	template <typename C, typename V, typename Eq, typename H>
+	void csv(std::ostream &os, const Map<C, V, Eq, H> &map, char sep = ',') {
+		csv_to(stream_sink(os), map, sep);
+	}
+
+	/**
+		@brief Esporta la mappa in formato CSV (o TSV) su un file
+		descriptor, con una sola write per blocco.
+
+		@param fd file descriptor aperto in scrittura
+		@param map mappa da esportare
+		@param sep separatore dei campi
+		@throw ioException se la scrittura fallisce
+	*/
+	template <typename C, typename V, typename Eq, typename H>
+	void csv(int fd, const Map<C, V, Eq, H> &map, char sep = ',') {
+		csv_to(fd_sink(fd), map, sep);
+	}
+
+	/**
+		@brief Esporta la mappa in formato JSON-lines su uno stream.
+
+		Ogni coppia è scritta su una riga {"key":...,"value":...}; i
+		numeri sono scritti come numeri JSON, tutto il resto come stringa.
+		I numeri in virgola mobile non finiti (infinito, NaN), che JSON
+		non può rappresentare, sono scritti come null.
+
+		@param os stream di output
+		@param map mappa da esportare
+	*/
+	template <typename C, typename V, typename Eq, typename H>
+	void jsonl(std::ostream &os, const Map<C, V, Eq, H> &map) {
+		jsonl_to(stream_sink(os), map);
+	}
+
+	/**
+		@brief Esporta la mappa in formato JSON-lines su un file
+		descriptor, con una sola write per blocco.
+
+		@param fd file descriptor aperto in scrittura
+		@param map mappa da esportare
+		@throw ioException se la scrittura fallisce
+	*/
+	template <typename C, typename V, typename Eq, typename H>
+	void jsonl(int fd, const Map<C, V, Eq, H> &map) {
+		jsonl_to(fd_sink(fd), map);
+	}
+
+	/**
+		@brief Esporta la mappa in formato CSV verso una destinazione
+		generica.
+
+		@param sink funzione invocata come sink(dati, lunghezza) per
+		ogni blocco
+		@param map mappa da esportare
+		@param sep separatore dei campi
+	*/
+	template <typename Sink, typename C, typename V, typename Eq, typename H>
+	void csv_to(Sink sink, const Map<C, V, Eq, H> &map, char sep = ',') {
+		_buf.clear();
+
+		for (const Pair<C, V> &p : map) {
+			append_csv(p.key, sep);
+			_buf.push_back(sep);
+			append_csv(p.value, sep);
+			_buf.push_back('\n');
+
+			if (_buf.size() >= _chunk)
+				flush(sink);
+		}
+
+		flush(sink);
+	}
+
+	/**
+		@brief Esporta la mappa in formato JSON-lines verso una
+		destinazione generica.
+
+		@param sink funzione invocata come sink(dati, lunghezza) per
+		ogni blocco
+		@param map mappa da esportare
+	*/
+	template <typename Sink, typename C, typename V, typename Eq, typename H>
+	void jsonl_to(Sink sink, const Map<C, V, Eq, H> &map) {
+		_buf.clear();
+
+		for (const Pair<C, V> &p : map) {
+			_buf.append("{\"key\":");
+			append_json(p.key);
+			_buf.append(",\"value\":");
+			append_json(p.value);
+			_buf.append("}\n");
+
+			if (_buf.size() >= _chunk)
+				flush(sink);
+		}
+
+		flush(sink);
+	}
+
+private:
+	/**
+		Destinazione che scrive su uno std::ostream
+	*/
+	struct stream_sink {
+		std::ostream &os;
+
+		explicit stream_sink(std::ostream &o) : os(o) {}
+
+		void operator()(const char *data, std::size_t n) const {
+			os.write(data, static_cast<std::streamsize>(n));
+		}
+	};
+
+	/**
+		Destinazione che scrive su un file descriptor
+	*/
+	struct fd_sink {
+		int fd;
+
+		explicit fd_sink(int f) : fd(f) {}
+
+		void operator()(const char *data, std::size_t n) const {
+			// write può scrivere meno byte di quelli richiesti o essere
+			// interrotta da un segnale: si ripete fino al completamento
+			while (n > 0) {
+				ssize_t w = ::write(fd, data, n);
+				if (w < 0) {
+					if (errno == EINTR)
+						continue;
+					throw ioException("Scrittura dell'esportazione fallita.");
+				}
+				data += w;
+				n -= static_cast<std::size_t>(w);
+			}
+		}
+	};
+
+	// Scrive il contenuto del buffer sulla destinazione e lo svuota
+	template <typename Sink>
+	void flush(Sink &sink) {
+		if (!_buf.empty())
+			sink(_buf.data(), _buf.size());
+		_buf.clear(); // la capacità viene mantenuta
+	}
+
+	// Aggiunge al buffer un numero convertito con std::to_chars
+	template <typename T>
+	void append_number(const T &v) {
+		char tmp[64];
+		std::to_chars_result r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+		_buf.append(tmp, r.ptr);
+	}
+
+	// Converte in testo un dato non numerico
+	template <typename T>
+	const std::string &text(const T &v) {
+		if constexpr (std::is_same<T, std::string>::value) {
+			return v;
+		} else {
+			_tmp.str(std::string());
+			_tmp << v;
+			_text = _tmp.str();
+			return _text;
+		}
+	}
+
+	// Aggiunge al buffer un campo CSV
+	template <typename T>
+	void append_csv(const T &v, char sep) {
+		if constexpr (std::is_same<T, bool>::value) {
+			_buf.push_back(v ? '1' : '0');
+		} else if constexpr (std::is_same<T, char>::value) {
+			append_csv(std::string(1, v), sep);
+		} else if constexpr (std::is_arithmetic<T>::value) {
+			append_number(v);
+		} else {
+			const std::string &s = text(v);
+
+			bool quote = false;
+			for (char c : s)
+				quote = quote || c == sep || c == '"' || c == '\r' || c == '\n';
+
+			if (!quote) {
+				_buf.append(s);
+				return;
+			}
+
+			_buf.push_back('"');
+			for (char c : s) {
+				if (c == '"')
+					_buf.push_back('"');
+				_buf.push_back(c);
+			}
+			_buf.push_back('"');
+		}
+	}
+
+	// Aggiunge al buffer un valore JSON
+	template <typename T>
+	void append_json(const T &v) {
+		if constexpr (std::is_same<T, bool>::value) {
+			_buf.append(v ? "true" : "false");
+		} else if constexpr (std::is_same<T, char>::value) {
+			append_json(std::string(1, v));
+		} else if constexpr (std::is_floating_point<T>::value) {
+			if (std::isfinite(v))
+				append_number(v);
+			else
+				_buf.append("null");
+		} else if constexpr (std::is_arithmetic<T>::value) {
+			append_number(v);
+		} else {
+			const char *hex = "0123456789abcdef";
+			const std::string &s = text(v);
+
+			_buf.push_back('"');
+			for (char c : s) {
+				unsigned char u = static_cast<unsigned char>(c);
+				if (c == '"' || c == '\\') {
+					_buf.push_back('\\');
+					_buf.push_back(c);
+				} else if (u < 0x20) {
+					_buf.append("\\u00");
+					_buf.push_back(hex[u >> 4]);
+					_buf.push_back(hex[u & 0xF]);
+				} else {
+					_buf.push_back(c);
+				}
+			}
+			_buf.push_back('"');
+		}
+	}
+
+	std::size_t _chunk; // dimensione dei blocchi scritti
+	std::string _buf; // buffer di formattazione riutilizzato
+	std::ostringstream _tmp; // stream per i tipi senza conversione diretta
+	std::string _text; // testo dell'ultimo dato convertito con _tmp
+};
+
+#endif
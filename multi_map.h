@@ -0,0 +1,258 @@
+#ifndef MULTI_MAP_H
+#define MULTI_MAP_H
+
+#include <vector> // std::vector
+#include <span> // std::span
+#include <utility> // std::move
+#include "map.h"
+
+/**
+	@brief Classe MultiMap
+
+	Mappa che associa ad ogni chiave più valori. I valori di tutte le
+	chiavi sono memorizzati in un unico vettore condiviso, in cui ogni
+	chiave occupa un segmento contiguo; la Map interna associa ad ogni
+	chiave solo la posizione del proprio segmento. Rispetto a
+	Map<C, std::vector<V>, Eq> non serve un'allocazione per chiave e i
+	valori si leggono senza copiarli.
+
+	Quando un segmento è pieno viene esteso sul posto se è l'ultimo del
+	vettore, altrimenti viene spostato in fondo con capacità doppia. Lo
+	spazio lasciato libero dagli spostamenti e dalle rimozioni viene
+	recuperato compattando il vettore quando supera lo spazio occupato
+	dai valori.
+
+	V deve essere costruibile di default.
+*/
+template <typename C, typename V, typename Eq, typename H = no_hash<C>>
+class MultiMap {
+	/**
+		@brief Struct Segment
+
+		Posizione dei valori di una chiave nel vettore condiviso.
+	*/
+	struct Segment {
+		std::size_t offset; // primo valore
+		std::size_t count; // valori presenti
+		std::size_t capacity; // valori che il segmento può contenere
+
+		Segment() : offset(0), count(0), capacity(0) {}
+	};
+
+	typedef Map<C, Segment, Eq, H> index_type;
+
+public:
+	/**
+		Costruttore
+
+		@param initial_capacity capacità del segmento creato per una
+		nuova chiave (almeno 1)
+	*/
+	explicit MultiMap(std::size_t initial_capacity = 2)
+		: _initial(initial_capacity ? initial_capacity : 1), _garbage(0), _values(0) {}
+
+	/**
+		@brief Aggiunge un valore ai valori di una chiave.
+
+		Se la chiave non è presente viene aggiunta. Invalida gli span
+		restituiti in precedenza da values.
+
+		@param key chiave
+		@param v valore da aggiungere
+		@throw se l'allocazione o la copia falliscono lancia un'eccezione
+	*/
+	void append(const C &key, const V &v) {
+		typename index_type::iterator i = _index.find(key);
+		if (i == _index.end()) {
+			Segment s;
+			s.offset = _pool.size();
+			s.capacity = _initial;
+			_pool.resize(_pool.size() + _initial);
+			try {
+				// La ricerca è appena fallita: niente secondo controllo
+				// dei duplicati, e la nuova coppia è in testa alla lista
+				_index.add_unchecked(key, s);
+			} catch(...) {
+				_pool.resize(s.offset);
+				throw;
+			}
+			i = _index.begin();
+		}
+
+		Segment &s = i->value;
+		if (s.count == s.capacity)
+			grow(s);
+
+		_pool[s.offset + s.count] = v;
+		s.count++;
+		_values++;
+	}
+
+	/**
+		@brief Valori associati ad una chiave, senza copiarli.
+
+		Lo span resta valido fino alla successiva modifica della mappa.
+
+		@param key chiave
+		@return i valori nell'ordine di inserimento (vuoto se la chiave
+		non è presente)
+	*/
+	std::span<const V> values(const C &key) const {
+		typename index_type::const_iterator i = _index.find(key);
+		if (i == _index.end())
+			return std::span<const V>();
+		return std::span<const V>(_pool.data() + i->value.offset, i->value.count);
+	}
+
+	/**
+		@param key chiave
+		@return numero di valori associati alla chiave (0 se non presente)
+	*/
+	std::size_t count(const C &key) const {
+		typename index_type::const_iterator i = _index.find(key);
+		return i == _index.end() ? 0 : i->value.count;
+	}
+
+	/**
+		@brief Verifica l'esistenza di una chiave.
+	*/
+	bool exists(const C &key) const {
+		return _index.exists(key);
+	}
+
+	/**
+		@brief Rimuove una chiave con tutti i suoi valori.
+
+		@param key chiave
+		@throw keyNotFoundException se la chiave non è presente
+	*/
+	void remove(const C &key) {
+		typename index_type::iterator i = _index.find(key);
+		if (i == _index.end())
+			throw keyNotFoundException("Chiave non trovata nella mappa.");
+
+		Segment s = i->value;
+		_index.remove(key);
+
+		// I valori rimossi vengono distrutti subito, lo spazio viene
+		// recuperato alla compattazione
+		for (std::size_t k = 0; k < s.count; ++k)
+			_pool[s.offset + k] = V();
+		_garbage += s.capacity;
+		_values -= s.count;
+	}
+
+	/**
+		@return numero di chiavi
+	*/
+	unsigned int size() const {
+		return _index.size();
+	}
+
+	/**
+		@return numero totale di valori
+	*/
+	std::size_t total_values() const {
+		return _values;
+	}
+
+	/**
+		@brief Compatta il vettore dei valori.
+
+		I segmenti vengono copiati uno dopo l'altro, senza spazio libero
+		tra di essi né in fondo ad ognuno. Invalida gli span restituiti
+		da values.
+	*/
+	void compact() {
+		std::vector<V> pool;
+		pool.reserve(_values);
+
+		for (typename index_type::iterator i = _index.begin(); i != _index.end(); ++i) {
+			Segment &s = i->value;
+			std::size_t offset = pool.size();
+			for (std::size_t k = 0; k < s.count; ++k)
+				pool.push_back(std::move(_pool[s.offset + k]));
+			s.offset = offset;
+			s.capacity = s.count;
+		}
+
+		_pool.swap(pool);
+		_garbage = 0;
+	}
+
+	/**
+		@brief Occupazione di memoria.
+
+		Struttura: l'indice delle chiavi. Dati: i valori presenti.
+		Riservato: la capacità inutilizzata del vettore dei valori
+		(segmenti non pieni e spazio da recuperare).
+
+		@return occupazione di memoria in byte
+	*/
+	MemoryUsage memory_usage() const {
+		MemoryUsage index = _index.memory_usage();
+		MemoryUsage m;
+
+		m.structure = index.total - sizeof(index_type) + sizeof(MultiMap);
+		for (typename index_type::const_iterator i = _index.begin(); i != _index.end(); ++i)
+			for (std::size_t k = 0; k < i->value.count; ++k)
+				m.payload += map_heap_bytes(_pool[i->value.offset + k]);
+		m.payload += _values * sizeof(V);
+		m.reserved = (_pool.capacity() - _values) * sizeof(V);
+		m.total = m.structure + m.payload + m.reserved;
+
+		return m;
+	}
+
+	/**
+		@return l'indice delle chiavi, per l'accesso in lettura
+	*/
+	const index_type &index() const {
+		return _index;
+	}
+
+private:
+	/**
+		@brief Raddoppia la capacità di un segmento pieno.
+	*/
+	void grow(Segment &s) {
+		std::size_t capacity = s.capacity * 2;
+
+		// Ultimo segmento del vettore: si estende sul posto
+		if (s.offset + s.capacity == _pool.size()) {
+			_pool.resize(s.offset + capacity);
+			s.capacity = capacity;
+			return;
+		}
+
+		// Lo spazio da recuperare supera quello dei valori: si compatta,
+		// dopodiché il segmento da estendere potrebbe essere l'ultimo
+		if (_garbage + s.capacity > _values) {
+			compact();
+			if (s.offset + s.capacity == _pool.size()) {
+				_pool.resize(s.offset + capacity);
+				s.capacity = capacity;
+				return;
+			}
+		}
+
+		std::size_t offset = _pool.size();
+		_pool.resize(offset + capacity);
+		for (std::size_t k = 0; k < s.count; ++k)
+			_pool[offset + k] = std::move(_pool[s.offset + k]);
+		for (std::size_t k = 0; k < s.count; ++k)
+			_pool[s.offset + k] = V();
+
+		_garbage += s.capacity;
+		s.offset = offset;
+		s.capacity = capacity;
+	}
+
+	index_type _index; // posizione dei valori di ogni chiave
+	std::vector<V> _pool; // valori di tutte le chiavi
+	std::size_t _initial; // capacità iniziale dei segmenti
+	std::size_t _garbage; // valori del vettore non appartenenti ad alcun segmento
+	std::size_t _values; // valori presenti
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include "thread_pool.h"
+
+namespace {
+	// Indice del worker corrente (-1 per i thread esterni al pool)
+	thread_local int current_worker = -1;
+	// Pool a cui appartiene il worker corrente
+	thread_local const ThreadPool *current_pool = nullptr;
+}
+
+ThreadPool::ThreadPool(unsigned int nthreads)
+	: _queued(0), _pending(0), _next(0), _stop(false) {
+	if (nthreads == 0)
+		nthreads = std::thread::hardware_concurrency();
+	if (nthreads == 0)
+		nthreads = 1;
+
+	for (unsigned int i = 0; i < nthreads; ++i)
+		_workers.push_back(std::unique_ptr<Worker>(new Worker()));
+
+	for (unsigned int i = 0; i < nthreads; ++i)
+		_threads.push_back(std::thread(&ThreadPool::run, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock<std::mutex> lock(_m);
+		_cv_done.wait(lock, [this] { return _pending == 0; });
+		_stop = true;
+	}
+	_cv_task.notify_all();
+
+	for (std::thread &t : _threads)
+		t.join();
+}
+
+void ThreadPool::submit(task t) {
+	unsigned int id;
+
+	// Un task che genera altri task li accoda nella propria coda,
+	// gli altri worker potranno eventualmente rubarli
+	if (current_pool == this) {
+		id = static_cast<unsigned int>(current_worker);
+	} else {
+		std::lock_guard<std::mutex> lock(_m);
+		id = _next;
+		_next = (_next + 1) % _workers.size();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_workers[id]->m);
+		_workers[id]->tasks.push_back(std::move(t));
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_m);
+		++_queued;
+		++_pending;
+	}
+	_cv_task.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(_m);
+	_cv_done.wait(lock, [this] { return _pending == 0; });
+
+	if (_error) {
+		std::exception_ptr e = _error;
+		_error = nullptr;
+		std::rethrow_exception(e);
+	}
+}
+
+unsigned int ThreadPool::size() const {
+	return static_cast<unsigned int>(_threads.size());
+}
+
+bool ThreadPool::try_pop(unsigned int id, task &t) {
+	// Prima la propria coda, dal fondo (LIFO, migliore località)
+	{
+		std::lock_guard<std::mutex> lock(_workers[id]->m);
+		if (!_workers[id]->tasks.empty()) {
+			t = std::move(_workers[id]->tasks.back());
+			_workers[id]->tasks.pop_back();
+			return true;
+		}
+	}
+
+	// Poi le code degli altri worker, dalla testa (FIFO)
+	for (unsigned int i = 1; i < _workers.size(); ++i) {
+		Worker &w = *_workers[(id + i) % _workers.size()];
+		std::lock_guard<std::mutex> lock(w.m);
+		if (!w.tasks.empty()) {
+			t = std::move(w.tasks.front());
+			w.tasks.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::run(unsigned int id) {
+	current_worker = static_cast<int>(id);
+	current_pool = this;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(_m);
+			_cv_task.wait(lock, [this] { return _stop || _queued > 0; });
+			if (_queued == 0)
+				return; // _stop e nessun task rimasto
+			--_queued; // prenota un task presente in una delle code
+		}
+
+		// Il task prenotato si trova sicuramente in una delle code,
+		// ma un altro worker potrebbe averlo appena spostato: si riprova
+		task t;
+		while (!try_pop(id, t))
+			std::this_thread::yield();
+
+		try {
+			t();
+		} catch(...) {
+			std::lock_guard<std::mutex> lock(_m);
+			if (!_error)
+				_error = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_m);
+			if (--_pending == 0)
+				_cv_done.notify_all();
+		}
+	}
+}
+
+TaskGroup::TaskGroup(ThreadPool &pool) : _pool(pool), _pending(0) {}
+
+TaskGroup::~TaskGroup() {
+	std::unique_lock<std::mutex> lock(_m);
+	_cv_done.wait(lock, [this] { return _pending == 0; });
+}
+
+void TaskGroup::run(ThreadPool::task t) {
+	{
+		std::lock_guard<std::mutex> lock(_m);
+		++_pending;
+	}
+
+	// Le eccezioni vengono raccolte dal gruppo e non arrivano al pool
+	try {
+		_pool.submit([this, t] {
+			std::exception_ptr e;
+			try {
+				t();
+			} catch(...) {
+				e = std::current_exception();
+			}
+
+			// La notifica avviene con il mutex acquisito: il gruppo non può
+			// essere distrutto finché il task non lo ha rilasciato
+			std::lock_guard<std::mutex> lock(_m);
+			if (e && !_error)
+				_error = e;
+			if (--_pending == 0)
+				_cv_done.notify_all();
+		});
+	} catch(...) {
+		// Il task non è stato accodato: senza annullare il conteggio
+		// wait e il distruttore attenderebbero per sempre
+		std::lock_guard<std::mutex> lock(_m);
+		if (--_pending == 0)
+			_cv_done.notify_all();
+		throw;
+	}
+}
+
+void TaskGroup::wait() {
+	std::unique_lock<std::mutex> lock(_m);
+	_cv_done.wait(lock, [this] { return _pending == 0; });
+
+	if (_error) {
+		std::exception_ptr e = _error;
+		_error = nullptr;
+		std::rethrow_exception(e);
+	}
+}
@@ -0,0 +1,147 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <functional> // std::function
+#include <vector> // std::vector
+#include <deque> // std::deque
+#include <thread> // std::thread
+#include <mutex> // std::mutex
+#include <condition_variable> // std::condition_variable
+#include <exception> // std::exception_ptr
+#include <memory> // std::unique_ptr
+
+/**
+	@brief Classe ThreadPool
+
+	Pool di thread con work-stealing utilizzato dalle operazioni
+	parallele della classe Map. Ogni worker possiede una propria coda
+	di task: estrae i task dal fondo della propria coda e, quando questa
+	è vuota, "ruba" dalla testa delle code degli altri worker.
+	Il numero di thread è configurabile alla costruzione.
+*/
+class ThreadPool {
+public:
+	typedef std::function<void()> task;
+
+	/**
+		Costruttore
+
+		@param nthreads numero di thread del pool (se 0 viene usato
+		il numero di core disponibili, e comunque almeno 1)
+	*/
+	explicit ThreadPool(unsigned int nthreads = 0);
+
+	/**
+		Distruttore
+
+		Attende il completamento dei task in coda e termina i thread.
+	*/
+	~ThreadPool();
+
+	/**
+		@brief Accoda un task nel pool.
+
+		Se chiamata da un worker del pool il task viene accodato nella
+		coda di quel worker, altrimenti le code vengono scelte a turno.
+
+		@param t task da eseguire
+	*/
+	void submit(task t);
+
+	/**
+		@brief Attende il completamento di tutti i task accodati.
+
+		Non deve essere chiamata dall'interno di un task del pool.
+
+		@throw rilancia la prima eccezione sollevata da un task
+	*/
+	void wait();
+
+	/**
+		@return numero di thread del pool
+	*/
+	unsigned int size() const;
+
+private:
+	/**
+		Coda di task di un singolo worker
+	*/
+	struct Worker {
+		std::deque<task> tasks;
+		std::mutex m;
+	};
+
+	void run(unsigned int id);
+	bool try_pop(unsigned int id, task &t);
+
+	ThreadPool(const ThreadPool &other); // non copiabile
+	ThreadPool& operator=(const ThreadPool &other); // non assegnabile
+
+	std::vector<std::unique_ptr<Worker>> _workers; // code dei worker
+	std::vector<std::thread> _threads; // thread del pool
+	std::mutex _m; // protegge i contatori e l'eccezione
+	std::condition_variable _cv_task; // segnala nuovi task
+	std::condition_variable _cv_done; // segnala il completamento
+	unsigned int _queued; // task accodati non ancora prelevati
+	unsigned int _pending; // task accodati non ancora completati
+	unsigned int _next; // prossima coda per submit esterni
+	bool _stop; // richiesta di terminazione
+	std::exception_ptr _error; // prima eccezione sollevata da un task
+};
+
+/**
+	@brief Classe TaskGroup
+
+	Gruppo di task eseguiti su un ThreadPool condiviso. A differenza di
+	ThreadPool::wait, wait attende solo i task del gruppo e rilancia
+	solo le loro eccezioni, per cui più thread possono usare lo stesso
+	pool contemporaneamente senza attendere il lavoro degli altri né
+	riceverne gli errori.
+*/
+class TaskGroup {
+public:
+	/**
+		Costruttore
+
+		@param pool pool su cui eseguire i task
+	*/
+	explicit TaskGroup(ThreadPool &pool);
+
+	/**
+		Distruttore
+
+		Attende il completamento dei task del gruppo, ignorandone le
+		eccezioni non ancora rilanciate da wait.
+	*/
+	~TaskGroup();
+
+	/**
+		@brief Accoda un task del gruppo nel pool.
+
+		@param t task da eseguire
+		@throw se il task non può essere accodato rilancia l'eccezione;
+		il task non fa parte del gruppo
+	*/
+	void run(ThreadPool::task t);
+
+	/**
+		@brief Attende il completamento dei task del gruppo.
+
+		Non deve essere chiamata dall'interno di un task del pool.
+
+		@throw rilancia la prima eccezione sollevata da un task del gruppo
+	*/
+	void wait();
+
+private:
+	TaskGroup(const TaskGroup &other); // non copiabile
+	TaskGroup& operator=(const TaskGroup &other); // non assegnabile
+
+	ThreadPool &_pool; // pool che esegue i task
+	std::mutex _m; // protegge il contatore e l'eccezione
+	std::condition_variable _cv_done; // segnala il completamento
+	unsigned int _pending; // task del gruppo non ancora completati
+	std::exception_ptr _error; // prima eccezione sollevata da un task del gruppo
+};
+
+#endif